@@ -0,0 +1,210 @@
+// Copyright 2020 Kevin B. Hendricks, Stratford Ontario  All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+
+#ifdef _MSC_VER
+#define GUMBO_THREAD_LOCAL __declspec(thread)
+#else
+#define GUMBO_THREAD_LOCAL __thread
+#endif
+
+// Blocks are kept aligned to this, it is also the size of a block header
+#define GUMBO_ALIGNMENT 16
+
+// Arenas grow by chunks of this size, larger blocks get a chunk of their own
+#define GUMBO_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct GumboInternalBlockHeader {
+  GumboArena* arena;   // NULL for blocks from the heap
+  size_t size;         // as requested by the caller
+} GumboBlockHeader;
+
+typedef struct GumboInternalArenaChunk {
+  struct GumboInternalArenaChunk* next;
+  size_t size;
+  size_t used;
+} GumboArenaChunk;
+
+struct GumboInternalArena {
+  GumboArenaChunk* chunks;         // the chunk being filled comes first
+  GumboBlockHeader* last;          // most recent block, resized in place
+  GumboArenaChunk* last_chunk;
+  bool edited;
+};
+
+#define BLOCK_HEADER_SIZE GUMBO_ALIGNMENT
+#define CHUNK_HEADER_SIZE \
+  ((sizeof(GumboArenaChunk) + GUMBO_ALIGNMENT - 1) & ~(size_t)(GUMBO_ALIGNMENT - 1))
+
+static GUMBO_THREAD_LOCAL GumboArena* active_arena = NULL;
+
+static inline size_t align_size(size_t size) {
+  return (size + GUMBO_ALIGNMENT - 1) & ~(size_t)(GUMBO_ALIGNMENT - 1);
+}
+
+static inline GumboBlockHeader* header_of(const void* ptr) {
+  return (GumboBlockHeader*)((char*) ptr - BLOCK_HEADER_SIZE);
+}
+
+static inline void* block_of(GumboBlockHeader* header) {
+  return (char*) header + BLOCK_HEADER_SIZE;
+}
+
+static inline char* chunk_data(GumboArenaChunk* chunk) {
+  return (char*) chunk + CHUNK_HEADER_SIZE;
+}
+
+static GumboArenaChunk* arena_new_chunk(GumboArena* arena, size_t needed) {
+  size_t size = needed > GUMBO_ARENA_CHUNK_SIZE ? needed : GUMBO_ARENA_CHUNK_SIZE;
+  GumboArenaChunk* chunk = gumbo_user_allocator(NULL, CHUNK_HEADER_SIZE + size);
+  chunk->size = size;
+  chunk->used = 0;
+  if (arena->chunks && (size > GUMBO_ARENA_CHUNK_SIZE)) {
+    // an oversized block should not retire the chunk still being filled
+    chunk->next = arena->chunks->next;
+    arena->chunks->next = chunk;
+  } else {
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+  }
+  return chunk;
+}
+
+static void* arena_malloc(GumboArena* arena, size_t size) {
+  size_t needed = BLOCK_HEADER_SIZE + align_size(size);
+  GumboArenaChunk* chunk = arena->chunks;
+  if (!chunk || (chunk->size - chunk->used < needed)) {
+    chunk = arena_new_chunk(arena, needed);
+  }
+  GumboBlockHeader* header = (GumboBlockHeader*)(chunk_data(chunk) + chunk->used);
+  chunk->used += needed;
+  header->arena = arena;
+  header->size = size;
+  arena->last = header;
+  arena->last_chunk = chunk;
+  return block_of(header);
+}
+
+static void* arena_realloc(GumboBlockHeader* header, size_t size) {
+  GumboArena* arena = header->arena;
+  size_t old_size = align_size(header->size);
+  size_t new_size = align_size(size);
+  if (arena->last == header) {
+    // the most recent block can simply take more of its chunk
+    GumboArenaChunk* chunk = arena->last_chunk;
+    if ((new_size <= old_size) || (chunk->size - chunk->used >= new_size - old_size)) {
+      chunk->used = chunk->used - old_size + new_size;
+      header->size = size;
+      return block_of(header);
+    }
+  }
+  if (size <= header->size) {
+    return block_of(header);
+  }
+  void* block = arena_malloc(arena, size);
+  memcpy(block, block_of(header), header->size);
+  return block;
+}
+
+static void arena_free(GumboBlockHeader* header) {
+  // only the most recent block can be handed back, the rest goes with the arena
+  GumboArena* arena = header->arena;
+  if (arena->last == header) {
+    arena->last_chunk->used -= BLOCK_HEADER_SIZE + align_size(header->size);
+    arena->last = NULL;
+  }
+}
+
+GumboArena* gumbo_arena_create(void) {
+  assert(sizeof(GumboBlockHeader) <= BLOCK_HEADER_SIZE);
+  GumboArena* arena = gumbo_user_allocator(NULL, sizeof(GumboArena));
+  arena->chunks = NULL;
+  arena->last = NULL;
+  arena->last_chunk = NULL;
+  arena->edited = false;
+  return arena;
+}
+
+void gumbo_arena_destroy(GumboArena* arena) {
+  if (!arena) {
+    return;
+  }
+  assert(active_arena != arena);
+  GumboArenaChunk* chunk = arena->chunks;
+  while (chunk) {
+    GumboArenaChunk* next = chunk->next;
+    gumbo_user_free(chunk);
+    chunk = next;
+  }
+  gumbo_user_free(arena);
+}
+
+GumboArena* gumbo_arena_set_active(GumboArena* arena) {
+  GumboArena* previous = active_arena;
+  active_arena = arena;
+  return previous;
+}
+
+void gumbo_arena_note_edit(const void* ptr) {
+  if (ptr && header_of(ptr)->arena) {
+    header_of(ptr)->arena->edited = true;
+  }
+}
+
+bool gumbo_arena_owns_unedited(const void* ptr) {
+  return ptr && header_of(ptr)->arena && !header_of(ptr)->arena->edited;
+}
+
+void* gumbo_malloc(size_t size) {
+  if (active_arena) {
+    return arena_malloc(active_arena, size);
+  }
+  GumboBlockHeader* header = gumbo_user_allocator(NULL, BLOCK_HEADER_SIZE + size);
+  header->arena = NULL;
+  header->size = size;
+  return block_of(header);
+}
+
+void* gumbo_realloc(void* ptr, size_t size) {
+  if (!ptr) {
+    return gumbo_malloc(size);
+  }
+  GumboBlockHeader* header = header_of(ptr);
+  if (header->arena) {
+    return arena_realloc(header, size);
+  }
+  header = gumbo_user_allocator(header, BLOCK_HEADER_SIZE + size);
+  header->size = size;
+  return block_of(header);
+}
+
+void gumbo_free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  GumboBlockHeader* header = header_of(ptr);
+  if (header->arena) {
+    arena_free(header);
+    return;
+  }
+  gumbo_user_free(header);
+}
@@ -0,0 +1,51 @@
+// Copyright 2020 Kevin B. Hendricks, Stratford Ontario  All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Per parse memory arenas.
+//
+// Every block handed out by gumbo_malloc carries a small header naming the
+// arena it came from (or none for the heap), so gumbo_realloc and gumbo_free
+// do the right thing no matter when they are called, including on trees that
+// are edited after the parse.  While a parse runs its options' arena is made
+// the active arena of the parsing thread; nothing is shared between threads.
+
+#ifndef GUMBO_ARENA_H_
+#define GUMBO_ARENA_H_
+
+#include <stdbool.h>
+
+#include "gumbo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Makes arena (which may be NULL for the heap) the one gumbo_malloc uses on
+// this thread and returns the previously active one so it can be restored.
+GumboArena* gumbo_arena_set_active(GumboArena* arena);
+
+// Records that a tree living in an arena had heap memory hung off of it by
+// one of the gumbo_edit routines.  ptr is any block of that tree; blocks
+// not owned by an arena are ignored.
+void gumbo_arena_note_edit(const void* ptr);
+
+// True if ptr lives in an arena whose tree has never been edited, meaning
+// releasing the arena frees everything reachable from it.
+bool gumbo_arena_owns_unedited(const void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // GUMBO_ARENA_H_
@@ -17,10 +17,12 @@
 #include "attribute.h"
 
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
+#include "arena.h"
 #include "util.h"
 #include "vector.h"
 
@@ -39,6 +41,7 @@ GumboAttribute* gumbo_get_attribute(
 
 void gumbo_attribute_set_value(GumboAttribute *attr, const char *value)
 {
+  gumbo_arena_note_edit(attr);
   gumbo_free((void *)attr->value);
   attr->value = gumbo_strdup(value);
   attr->original_value = kGumboEmptyString;
@@ -58,6 +61,9 @@ void gumbo_element_set_attribute(
   GumboVector *attributes = &element->attributes;
   GumboAttribute *attr = gumbo_get_attribute(attributes, name);
 
+  // elements only ever live inside a node
+  gumbo_arena_note_edit((const char *)element - offsetof(GumboNode, v));
+
   if (!attr) {
     attr = gumbo_malloc(sizeof(GumboAttribute));
     attr->value = NULL;
@@ -557,6 +557,11 @@ typedef void* (*GumboAllocatorFunction)(void* userdata, size_t size);
  */
 typedef void (*GumboDeallocatorFunction)(void* userdata, void* ptr);
 
+/**
+ * A memory arena a parse can be allocated from, see GumboOptions::arena.
+ */
+typedef struct GumboInternalArena GumboArena;
+
 /**
  * Input struct containing configuration options for the parser.
  * These let you specify alternate memory managers, provide different error
@@ -599,6 +604,17 @@ typedef struct GumboInternalOptions {
    * Default: 50
    */
   int max_errors;
+
+  /**
+   * Arena to carve the whole parse (nodes, attributes, strings, vectors and
+   * errors) out of instead of allocating each piece from the heap.  The
+   * arena belongs to the caller and must outlive the output; releasing it
+   * frees the tree, so gumbo_destroy_output only walks the tree if it was
+   * edited with the gumbo_edit routines.  An arena is not thread safe, use
+   * one per parse.
+   * Default: NULL (allocate from the heap).
+   */
+  GumboArena* arena;
 } GumboOptions;
 
 /** Default options struct; use this with gumbo_parse_with_options. */
@@ -688,6 +704,15 @@ GumboOutput* gumbo_parse_fragment(
 /** Release the memory used for the parse tree & parse errors. */
 void gumbo_destroy_output(GumboOutput* output);
 
+/** Create an empty arena for use with GumboOptions::arena. */
+GumboArena* gumbo_arena_create(void);
+
+/**
+ * Release an arena and everything allocated from it at once.  Call
+ * gumbo_destroy_output on any output parsed into it first.
+ */
+void gumbo_arena_destroy(GumboArena* arena);
+
 /** Allocate a new freestanding node */
 GumboNode *gumbo_create_node(GumboNodeType type);
 
@@ -19,6 +19,7 @@
 #include <string.h>
 #include <strings.h>
 
+#include "arena.h"
 #include "attribute.h"
 #include "vector.h"
 #include "gumbo.h"
@@ -141,6 +142,7 @@ void gumbo_append_node(GumboNode* parent, GumboNode* node) {
     assert(parent->type == GUMBO_NODE_DOCUMENT);
     children = &parent->v.document.children;
   }
+  gumbo_arena_note_edit(parent);
   node->parent = parent;
   node->index_within_parent = children->length;
   gumbo_vector_add((void*) node, children);
@@ -168,6 +170,7 @@ void gumbo_insert_node(GumboNode* node, GumboNode* target_parent, int target_ind
     }
     assert(index >= 0);
     assert(index < children->length);
+    gumbo_arena_note_edit(parent);
     node->parent = parent;
     node->index_within_parent = index;
     gumbo_vector_insert_at((void*) node, index, children);
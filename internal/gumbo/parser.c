@@ -20,6 +20,7 @@
 #include <string.h>
 #include <strings.h>
 
+#include "arena.h"
 #include "attribute.h"
 #include "error.h"
 #include "gumbo.h"
@@ -60,6 +61,7 @@ const GumboOptions kGumboDefaultOptions = {
   false,   /* stop_on_first_error */
   400,     /* max_tree_depth */
   50,      /* max_errors */
+  NULL,    /* arena */
 };
 
 static const GumboStringPiece kDoctypeHtml = GUMBO_STRING("html");
@@ -4506,6 +4508,8 @@ GumboOutput* gumbo_parse_fragment(
     const GumboTag fragment_ctx, const GumboNamespaceEnum fragment_namespace) {
   GumboParser parser;
   parser._options = options;
+  // everything below allocates from the arena, if any, through gumbo_malloc
+  GumboArena* previous_arena = gumbo_arena_set_active(options->arena);
   parser_state_init(&parser);
   // Must come after parser_state_init, since creating the document node must
   // reference parser_state->_current_node.
@@ -4653,6 +4657,7 @@ GumboOutput* gumbo_parse_fragment(
 
   parser_state_destroy(&parser);
   gumbo_tokenizer_state_destroy(&parser);
+  gumbo_arena_set_active(previous_arena);
   return parser._output;
 }
 
@@ -4671,6 +4676,10 @@ const char* gumbo_status_to_string(GumboOutputStatus status) {
 
 
 void gumbo_destroy_output(GumboOutput* output) {
+  // an untouched tree goes away with its arena
+  if (gumbo_arena_owns_unedited(output)) {
+    return;
+  }
   free_node(output->document);
   for (unsigned int i = 0; i < output->errors.length; ++i) {
     gumbo_error_destroy(output->errors.data[i]);
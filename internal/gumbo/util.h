@@ -34,15 +34,13 @@ extern "C" {
 extern void *(* gumbo_user_allocator)(void *, size_t);
 extern void (* gumbo_user_free)(void *);
 
-static inline void *gumbo_malloc(size_t size)
-{
-  return gumbo_user_allocator(NULL, size);
-}
+// Allocation goes to the active parse arena if there is one and to the
+// user allocator otherwise; see arena.h.
+void *gumbo_malloc(size_t size);
 
-static inline void *gumbo_realloc(void *ptr, size_t size)
-{
-  return gumbo_user_allocator(ptr, size);
-}
+void *gumbo_realloc(void *ptr, size_t size);
+
+void gumbo_free(void *ptr);
 
 static inline char *gumbo_strdup(const char *str)
 {
@@ -52,11 +50,6 @@ static inline char *gumbo_strdup(const char *str)
   return copy;
 }
 
-static inline void gumbo_free(void *ptr)
-{
-  gumbo_user_free(ptr);
-}
-
 static inline int gumbo_tolower(int c)
 {
   return c | ((c >= 'A' && c <= 'Z') << 5);
@@ -243,6 +243,12 @@ const FolderKeeper *Book::GetFolderKeeper() const
 }
 
 
+ZipEntryCache &Book::GetZipEntryCache()
+{
+    return m_ZipEntryCache;
+}
+
+
 
 OPFResource *Book::GetOPF()
 {
@@ -581,7 +587,8 @@ HTMLResource *Book::CreateSectionBreakOriginalResource(const QString &content, H
     html_resources.removeOne(new_resource);
     // Now, update references to the original file that are made in other files.
     // We can't assume that ids are unique in this case, and so need to use a different mechanism.
-    AnchorUpdates::UpdateExternalAnchors(html_resources, originating_bookpath, new_files);
+    AnchorUpdates::UpdateExternalAnchors(GetReferringHTMLResources(html_resources, QStringList() << originating_bookpath),
+                                         originating_bookpath, new_files);
     // Update TOC entries as well if an NCX exists:
     NCXResource * ncx_resource = GetNCX();
     if (ncx_resource) {
@@ -675,7 +682,8 @@ void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *orig
     AnchorUpdates::UpdateAllAnchorsWithIDs(new_files);
     // Now, update references to the original file that are made in other files.
     // We can't assume that ids are unique in this case, and so need to use a different mechanism.
-    AnchorUpdates::UpdateExternalAnchors(other_files, original_resource->GetRelativePath(), new_files);
+    AnchorUpdates::UpdateExternalAnchors(GetReferringHTMLResources(other_files, QStringList() << originating_bookpath),
+                                         originating_bookpath, new_files);
     // Update TOC entries as well if an NCX exists, they are optional on epub3
     NCXResource * ncx_resource = GetNCX();
     if (ncx_resource) {
@@ -688,9 +696,7 @@ void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *orig
 
 bool Book::IsDataWellFormed(HTMLResource *html_resource)
 {
-    XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(html_resource->GetText(), 
-                                                                         html_resource->GetEpubVersion());
-    return error.line == -1;
+    return html_resource->IsWellFormed();
 }
 
 
@@ -749,7 +755,7 @@ QHash <QString, QList<XhtmlDoc::XMLElement>> Book::GetLinkElements()
 std::tuple<QString, QList<XhtmlDoc::XMLElement>> Book::GetLinkElementsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                      XhtmlDoc::GetTagsInDocument(html_resource->GetText(), "a"));
+                           html_resource->GetLinkElements());
 }
 
 QStringList Book::GetStyleUrlsInHTMLFiles()
@@ -773,7 +779,7 @@ std::tuple<QString, QStringList> Book::GetStyleUrlsInHTMLFileMapped(HTMLResource
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
     // we need to convert this hreflist to bookpaths if possible
-    QStringList urllist = XhtmlDoc::GetAllDescendantStyleUrls(html_resource->GetText());
+    QStringList urllist = html_resource->GetDocumentFacts().style_urls;
     QStringList bookpaths;
     QRegularExpression url_file_search("url\\s*\\(\\s*['\"]?([^\\(\\)'\"]*)[\"']?\\)");
     foreach (QString url, urllist) {
@@ -808,12 +814,12 @@ QHash<QString, QStringList> Book::GetIdsInHTMLFiles()
 std::tuple<QString, QStringList> Book::GetIdsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantIDs(html_resource->GetText()));
+                           html_resource->GetDocumentFacts().ids);
 }
 
 QStringList Book::GetIdsInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantIDs(html_resource->GetText());
+    return html_resource->GetDocumentFacts().ids;
 }
 
 
@@ -861,12 +867,12 @@ QHash<QString, QStringList> Book::GetHrefsInHTMLFiles()
 std::tuple<QString, QStringList> Book::GetHrefsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantHrefs(html_resource->GetText()));
+                           html_resource->GetDocumentFacts().hrefs);
 }
 
 QStringList Book::GetClassesInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    return html_resource->GetDocumentFacts().classes;
 }
 
 QHash<QString, QStringList> Book::GetImagesInHTMLFiles()
@@ -982,8 +988,7 @@ std::tuple<QString, QStringList> Book::GetMediaInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList media_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), 
-                                                                       GIMAGE_TAGS + GVIDEO_TAGS + GAUDIO_TAGS);
+    QStringList media_hrefs = html_resource->GetDocumentFacts().media_paths;
     QStringList media_bookpaths;
     foreach(QString ahref, media_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -997,7 +1002,7 @@ std::tuple<QString, QStringList> Book::GetImagesInHTMLFileMapped(HTMLResource *h
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList image_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GIMAGE_TAGS);
+    QStringList image_hrefs = html_resource->GetDocumentFacts().image_paths;
     QStringList image_bookpaths;
     foreach(QString ahref, image_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1011,7 +1016,7 @@ std::tuple<QString, QStringList> Book::GetVideoInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList video_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GVIDEO_TAGS);
+    QStringList video_hrefs = html_resource->GetDocumentFacts().video_paths;
     QStringList video_bookpaths;
     foreach(QString ahref, video_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1025,7 +1030,7 @@ std::tuple<QString, QStringList> Book::GetAudioInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList audio_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GAUDIO_TAGS);
+    QStringList audio_hrefs = html_resource->GetDocumentFacts().audio_paths;
     QStringList audio_bookpaths;
     foreach(QString ahref, audio_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1051,9 +1056,7 @@ QList<HTMLResource *> Book::GetNonWellFormedHTMLFiles()
 std::pair<HTMLResource*, bool> Book::ResourceWellFormedMap(HTMLResource * html_resource) {
     std::pair<HTMLResource*, bool> res;
     res.first = html_resource;
-    XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(html_resource->GetText(),
-                                                                         html_resource->GetEpubVersion());
-    res.second = (error.line == -1);
+    res.second = html_resource->IsWellFormed();
     return res;
 }
 
@@ -1126,7 +1129,7 @@ std::tuple<QString, QStringList> Book::GetStylesheetsInHTMLFileMapped(HTMLResour
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList link_hrefs = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList link_hrefs = html_resource->GetDocumentFacts().linked_stylesheets;
     QStringList link_bookpaths;
     foreach(QString ahref, link_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1140,7 +1143,7 @@ std::tuple<QString, QStringList> Book::GetStylesheetsInHTMLFileMapped(HTMLResour
 QStringList Book::GetStylesheetsInHTMLFile(HTMLResource *html_resource)
 {
     // convert encoded links relative to a html resource to their book paths
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = html_resource->GetDocumentFacts().linked_stylesheets;
     QStringList results;
     QString html_folder = html_resource->GetFolder();
     foreach(QString stylelink, stylelinks) {
@@ -1176,7 +1179,7 @@ Resource *Book::MergeResources(QList<Resource *> resources)
     QList<QString> merged_bookpaths;
     QString version = sink_html_resource->GetEpubVersion();
     {
-        GumboInterface gi = GumboInterface(sink_html_resource->GetText(), version);
+        GumboInterface gi = GumboInterface(sink_html_resource->GetUtf8Text(), version);
         new_bodies << gi.get_body_contents();
         Resource *failed_resource = NULL;
         
@@ -1194,7 +1197,7 @@ Resource *Book::MergeResources(QList<Resource *> resources)
             }
 
             // Get the html document for this source resource.
-            GumboInterface ngi = GumboInterface(source_html_resource->GetText(), version);
+            GumboInterface ngi = GumboInterface(source_html_resource->GetUtf8Text(), version);
             new_bodies << ngi.get_body_contents();
             merged_bookpaths.append(source_resource->GetRelativePath());
         }
@@ -1220,6 +1223,7 @@ Resource *Book::MergeResources(QList<Resource *> resources)
     // It is the user's responsibility to ensure that all ids used across the two merged files are unique.
     // Reconcile all references to the files that were merged.
     QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(true);
+    html_resources = GetReferringHTMLResources(html_resources, merged_bookpaths);
     AnchorUpdates::UpdateAllAnchors(html_resources, merged_bookpaths, sink_html_resource);
     NCXResource * ncx_resource = GetNCX();
     if (ncx_resource) {
@@ -1400,7 +1404,7 @@ QPair<QString, QStringList> Book::GetRelLinksInOneFile(HTMLResource *html_resour
     Q_ASSERT(html_resource);
     QReadLocker locker(&html_resource->GetLock());
     QString htmldir = html_resource->GetFolder();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), html_resource->GetEpubVersion());
+    GumboInterface gi = GumboInterface(html_resource->GetUtf8Text(), html_resource->GetEpubVersion());
     gi.parse();
     QPair<QString, QStringList> link_pair;
     QStringList hreflist;
@@ -1433,3 +1437,19 @@ QPair<QString, QStringList> Book::GetOneFileIDs(HTMLResource *html_resource)
     id_pair.second = ids;
     return id_pair;
 }
+
+
+QList<HTMLResource *> Book::GetReferringHTMLResources(const QList<HTMLResource *> &candidates,
+                                                      const QStringList &bookpaths)
+{
+    ReferenceIndex *reference_index = m_Mainfolder->GetReferenceIndex();
+    reference_index->Refresh(m_Mainfolder->GetResourceList());
+    const QSet<Resource *> referring = reference_index->GetReferringResources(bookpaths);
+    QList<HTMLResource *> html_resources;
+    foreach(HTMLResource *html_resource, candidates) {
+        if (referring.contains(html_resource)) {
+            html_resources.append(html_resource);
+        }
+    }
+    return html_resources;
+}
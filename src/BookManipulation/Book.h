@@ -29,6 +29,7 @@
 #include <QUrl>
 #include "ResourceObjects/OPFParser.h"
 #include "BookManipulation/XhtmlDoc.h"
+#include "Misc/ZipEntryCache.h"
 #include "ResourceObjects/Resource.h"
 
 class CSSResource;
@@ -71,6 +72,14 @@ public:
      */
     const FolderKeeper *GetFolderKeeper() const;
 
+    /**
+     * Returns the compressed entries of the epub the book
+     * was last read from or saved to.
+     *
+     * @return A reference to the ZipEntryCache of the Book.
+     */
+    ZipEntryCache &GetZipEntryCache();
+
     /**
      * Returns the book's OPF file.
      *
@@ -421,6 +430,13 @@ private:
      */
     static QPair<QString, QStringList> GetOneFileIDs(HTMLResource *html_resource);
 
+    /**
+     * Returns the html files among candidates that refer to any
+     * of bookpaths, according to the refreshed reference index.
+     */
+    QList<HTMLResource *> GetReferringHTMLResources(const QList<HTMLResource *> &candidates,
+                                                    const QStringList &bookpaths);
+
 
     ////////////////////////////
     // PRIVATE MEMBER VARIABLES
@@ -432,6 +448,12 @@ private:
      */
     FolderKeeper *m_Mainfolder;
 
+    /**
+     * Where unchanged files can be copied from
+     * when the book is saved as an epub.
+     */
+    ZipEntryCache m_ZipEntryCache;
+
     /**
      * Stores the modified state of the book.
      */
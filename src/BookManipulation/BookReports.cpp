@@ -40,6 +40,24 @@
 
 
 
+// Returns the parsed stylesheets keyed by book path
+static QSharedPointer<const CSSInfo> GetOneCSSInfo(CSSResource *css_resource)
+{
+    return css_resource->GetCSSInfo();
+}
+
+static QHash<QString, QSharedPointer<const CSSInfo> > GetCSSInfos(const QList<CSSResource *> &css_resources)
+{
+    // stylesheets that have not changed come straight from their cache
+    const QList<QSharedPointer<const CSSInfo> > parsed = QtConcurrent::blockingMapped(css_resources, GetOneCSSInfo);
+    QHash<QString, QSharedPointer<const CSSInfo> > css_infos;
+    for (int i = 0; i < css_resources.count(); ++i) {
+        css_infos.insert(css_resources.at(i)->GetRelativePath(), parsed.at(i));
+    }
+    return css_infos;
+}
+
+
 // These GetHTMLClassUsage and GetAllHTMLClassUsage may look identical but they are not
 
 
@@ -48,21 +66,16 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Save each CSS file's text so we don't have to reload it when checking each HTML file
-    QHash<QString, QString> css_text;
-    foreach(CSSResource * css_resource, css_resources) {
-        QString css_filename = css_resource->GetRelativePath();
-        if (!css_text.contains(css_filename)) {
-            css_text[css_filename] = css_resource->GetText();
-        }
-    }
+    // Parse each CSS file once up front; the parsed selector indexes are
+    // only read by the workers so they can all share them
+    QHash<QString, QSharedPointer<const CSSInfo> > css_infos = GetCSSInfos(css_resources);
 
     QList<BookReports::StyleData*> html_classes_usage;
 
     QFuture< QList<BookReports::StyleData*> > usage_future;
     usage_future = QtConcurrent::mapped(html_resources, 
 					std::bind(ClassesUsedInHTMLFileMapped, 
-						  std::placeholders::_1, css_text));
+						  std::placeholders::_1, css_infos));
 
     for (int i = 0; i < usage_future.results().count(); i++) {
         html_classes_usage.append(usage_future.resultAt(i));
@@ -72,19 +85,20 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
 }
 
 
-QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLResource* html_resource, const QHash<QString, QString> &css_text)
+QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLResource* html_resource, const QHash<QString, QSharedPointer<const CSSInfo> > &css_infos)
 {
     QList<BookReports::StyleData *> html_classes_usage;
 
     // Get the unique list of classes in this file
     // list of element_name.class_name
-    QStringList classes_in_file = XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    XhtmlDoc::DocumentFacts facts = html_resource->GetDocumentFacts();
+    QStringList classes_in_file = facts.classes;
     classes_in_file.removeDuplicates();
 
     // Get the linked stylesheets for this file
     // returned as list of bookpaths to the stylesheets
     QStringList linked_stylesheets;
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = facts.linked_stylesheets;
     QString html_folder = html_resource->GetFolder();
     // convert links relative to a html resource to their book paths
     foreach(QString stylelink, stylelinks) {
@@ -108,9 +122,9 @@ QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLRes
 	// Look in each stylesheet
 	// css_filename here is a bookpath as used above
         foreach(QString css_filename, linked_stylesheets) {
-            if (css_text.contains(css_filename)) {
-                CSSInfo css_info(css_text[css_filename], true);
-		CSSInfo::CSSSelector *selector = css_info.getCSSSelectorForElementClass(element_part, class_part);
+            QSharedPointer<const CSSInfo> css_info = css_infos.value(css_filename);
+            if (css_info) {
+		CSSInfo::CSSSelector *selector = css_info->getCSSSelectorForElementClass(element_part, class_part);
                 // If class matched a selector in a linked stylesheet, we're done
                 if (selector && (selector->classNames.count() > 0)) {
 		    // css_filename is a book path
@@ -135,22 +149,16 @@ QList<BookReports::StyleData *> BookReports::GetAllHTMLClassUsage(QSharedPointer
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Save each CSS file's text so we don't have to reload it when checking each HTML file
-    QHash<QString, QString> css_text;
-    foreach(CSSResource * css_resource, css_resources) {
-        QString css_filename = css_resource->GetRelativePath();
-
-        if (!css_text.contains(css_filename)) {
-            css_text[css_filename] = css_resource->GetText();
-        }
-    }
+    // Parse each CSS file once up front; the parsed selector indexes are
+    // only read by the workers so they can all share them
+    QHash<QString, QSharedPointer<const CSSInfo> > css_infos = GetCSSInfos(css_resources);
 
     QList<BookReports::StyleData*> html_classes_usage;
 
     QFuture< QList<BookReports::StyleData*> > usage_future;
     usage_future = QtConcurrent::mapped(html_resources, 
 					std::bind(AllClassesUsedInHTMLFileMapped, 
-						  std::placeholders::_1, css_text));
+						  std::placeholders::_1, css_infos));
 
     for (int i = 0; i < usage_future.results().count(); i++) {
         html_classes_usage.append(usage_future.resultAt(i));
@@ -160,19 +168,20 @@ QList<BookReports::StyleData *> BookReports::GetAllHTMLClassUsage(QSharedPointer
 }
 
 
-QList<BookReports::StyleData *> BookReports::AllClassesUsedInHTMLFileMapped(HTMLResource* html_resource, const QHash<QString, QString> &css_text)
+QList<BookReports::StyleData *> BookReports::AllClassesUsedInHTMLFileMapped(HTMLResource* html_resource, const QHash<QString, QSharedPointer<const CSSInfo> > &css_infos)
 {
     QList<BookReports::StyleData *> html_classes_usage;
 
     // Get the unique list of classes in this file
     // list of element_name.class_name
-    QStringList classes_in_file = XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    XhtmlDoc::DocumentFacts facts = html_resource->GetDocumentFacts();
+    QStringList classes_in_file = facts.classes;
     classes_in_file.removeDuplicates();
 
     // Get the linked stylesheets for this file
     // returned as list of bookpaths to the stylesheets
     QStringList linked_stylesheets;
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = facts.linked_stylesheets;
     QString html_folder = html_resource->GetFolder();
     // convert links relative to a html resource to their book paths
     foreach(QString stylelink, stylelinks) {
@@ -191,9 +200,9 @@ QList<BookReports::StyleData *> BookReports::AllClassesUsedInHTMLFileMapped(HTML
         // Look in each stylesheet
 	// css_filename here is a bookpath as used above
         foreach(QString css_filename, linked_stylesheets) {
-            if (css_text.contains(css_filename)) {
-                CSSInfo css_info(css_text[css_filename], true);
-                QList<CSSInfo::CSSSelector *> selectors = css_info.getAllCSSSelectorsForElementClass(element_part, class_part);
+            QSharedPointer<const CSSInfo> css_info = css_infos.value(css_filename);
+            if (css_info) {
+                QList<CSSInfo::CSSSelector *> selectors = css_info->getAllCSSSelectorsForElementClass(element_part, class_part);
                 foreach(CSSInfo::CSSSelector * selector, selectors) {
                     // If class matched a selector in a linked stylesheet, we're done
                     if (selector && (selector->classNames.count() > 0)) {
@@ -225,9 +234,8 @@ QList<BookReports::StyleData *> BookReports::GetCSSSelectorUsage(QSharedPointer<
     QList<BookReports::StyleData *> css_selectors_usage;
     // Now check the CSS files to see if their classes appear in an HTML file
     foreach(CSSResource *css_resource, css_resources) {
-        QString text = css_resource->GetText();
-        CSSInfo css_info(text, true);
-        QList<CSSInfo::CSSSelector *> selectors = css_info.getClassSelectors();
+        QSharedPointer<const CSSInfo> css_info = css_resource->GetCSSInfo();
+        QList<CSSInfo::CSSSelector *> selectors = css_info->getClassSelectors();
         foreach(CSSInfo::CSSSelector * selector, selectors) {
             QString css_filename = css_resource->GetRelativePath();
             // Save the details for found or not found classes
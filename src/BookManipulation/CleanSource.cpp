@@ -22,9 +22,14 @@
 
 #include "Misc/EmbeddedPython.h"
 
+#include <QtCore/QCache>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
 #include <QtCore/QWriteLocker>
+#include <QtCore/QXmlStreamReader>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QProgressDialog>
 #include <QRegularExpression>
@@ -44,6 +49,9 @@ const QString SVG_NAMESPACE_PREFIX = "<\\s*[^>]*(xmlns\\s*:\\s*svg\\s*=\\s*(?:\"
 
 static const QStringList NUMERIC_NBSP = QStringList() << "&#160;" << "&#xa0;" << "&#x00a0;";
 
+// upper bound (in QChars) on the text held by the ProcessXML memo
+static const int PROCESSXML_CACHE_MAX_CHARS = 8 * 1024 * 1024;
+
 
 // Performs general cleaning (and improving)
 // of provided book XHTML source code
@@ -93,8 +101,11 @@ QString CleanSource::MendPrettify(const QString &source, const QString &version)
 
 
 // Repair XML if needed and PrettyPrint using BeautifulSoup4
-QString CleanSource::XMLPrettyPrintBS4(const QString &source, const QString mtype)
+QString CleanSource::XMLPrettyPrintBS4(const QString &source, const QString mtype, bool *ok)
 {
+    if (ok) {
+        *ok = false;
+    }
     int rv = 0;
     QString error_traceback;
     QList<QVariant> args;
@@ -102,17 +113,20 @@ QString CleanSource::XMLPrettyPrintBS4(const QString &source, const QString mtyp
     args.append(QVariant(mtype));
     EmbeddedPython * epython  = EmbeddedPython::instance();
 
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("repairXML"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
+    QVariant res = epython->runInPythonWorker( QString("xmlprocessor"),
+                                               QString("repairXML"),
+                                               args,
+                                               &rv,
+                                               error_traceback);    
     if (rv != 0) {
         Utility::DisplayStdWarningDialog(QString("error in xmlprocessor repairXML: ") + QString::number(rv), 
                                          error_traceback);
         // an error happened, return unchanged original
         return QString(source);
     }
+    if (ok) {
+        *ok = true;
+    }
     return res.toString();
 }
 
@@ -136,11 +150,11 @@ XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheck(const QString &source,
     args.append(QVariant(mtype));
     EmbeddedPython * epython  = EmbeddedPython::instance();
 
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("WellFormedXMLCheck"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
+    QVariant res = epython->runInPythonWorker( QString("xmlprocessor"),
+                                               QString("WellFormedXMLCheck"),
+                                               args,
+                                               &rv,
+                                               error_traceback);    
     if (rv != 0) {
         Utility::DisplayStdWarningDialog(QString("error in xmlprocessor WellFormedXMLCheck: ") + QString::number(rv), 
                                          error_traceback);
@@ -163,11 +177,11 @@ bool CleanSource::IsWellFormedXML(const QString &source, const QString mtype)
     args.append(QVariant(mtype));
     EmbeddedPython * epython  = EmbeddedPython::instance();
 
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("IsWellFormedXML"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
+    QVariant res = epython->runInPythonWorker( QString("xmlprocessor"),
+                                               QString("IsWellFormedXML"),
+                                               args,
+                                               &rv,
+                                               error_traceback);    
     if (rv != 0) {
         Utility::DisplayStdWarningDialog(QString("error in xmlprocessor IsWellFormedXML: ") + QString::number(rv), 
                                          error_traceback);
@@ -177,9 +191,72 @@ bool CleanSource::IsWellFormedXML(const QString &source, const QString mtype)
     return res.toBool();
 }
 
+// Memo of ProcessXML results keyed by a hash of the media type and source
+// so that repeated calls on an unchanged opf or ncx are nearly free
+static QMutex s_ProcessXMLMutex;
+static QCache<QByteArray, QString> s_ProcessXMLCache(PROCESSXML_CACHE_MAX_CHARS);
+
+static QByteArray ProcessXMLKey(const QString &source, const QString &mtype)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(mtype.toUtf8());
+    hash.addData("\0", 1);
+    hash.addData(reinterpret_cast<const char *>(source.constData()), source.size() * sizeof(QChar));
+    return hash.result();
+}
+
+static void ProcessXMLRemember(const QByteArray &key, const QString &result)
+{
+    int cost = qMax(result.size(), 1);
+    if (cost > PROCESSXML_CACHE_MAX_CHARS) return;
+    QMutexLocker locker(&s_ProcessXMLMutex);
+    s_ProcessXMLCache.insert(key, new QString(result), cost);
+}
+
 QString CleanSource::ProcessXML(const QString &source, const QString mtype)
 {
-    return XMLPrettyPrintBS4(source, mtype);
+    QByteArray key = ProcessXMLKey(source, mtype);
+    {
+        QMutexLocker locker(&s_ProcessXMLMutex);
+        QString *cached = s_ProcessXMLCache.object(key);
+        if (cached) {
+            return *cached;
+        }
+    }
+
+    QString result;
+    bool repaired = true;
+    // repairXML hands back well-formed data untouched for everything but the opf
+    // (which it always rebuilds), so check natively and skip python when we can
+    if ((mtype != "application/oebps-package+xml") && IsWellFormedXMLNative(source)) {
+        result = source;
+    } else {
+        result = XMLPrettyPrintBS4(source, mtype, &repaired);
+    }
+
+    // a failed repair may well succeed next time so it is not remembered
+    if (!repaired) {
+        return result;
+    }
+    ProcessXMLRemember(key, result);
+
+    // repaired output is stable under a second pass, so remember it as
+    // its own answer too since it is usually what gets handed back to us
+    if (result != source) {
+        ProcessXMLRemember(ProcessXMLKey(result, mtype), result);
+    }
+    return result;
+}
+
+// Strict non-validating check done in C++, any failure here simply means
+// the caller has to fall back to the lxml/BeautifulSoup based repair
+bool CleanSource::IsWellFormedXMLNative(const QString &source)
+{
+    QXmlStreamReader reader(source);
+    while (!reader.atEnd()) {
+        reader.readNext();
+    }
+    return !reader.hasError();
 }
 
 QString CleanSource::RemoveMetaCharset(const QString &source)
@@ -41,6 +41,7 @@ public:
     // Convert to valid XHTML with Mending
     static QString ToValidXHTML(const QString &source, const QString &version );
 
+    // Repair (when needed) and normalize xml, results are memoized by content
     static QString ProcessXML(const QString &source, const QString mtype="");
 
     static XhtmlDoc::WellFormedError WellFormedXMLCheck(const QString &source, const QString mtype="");
@@ -49,7 +50,8 @@ public:
 
     static QString MendPrettify(const QString &source, const QString &version);
 
-    static QString XMLPrettyPrintBS4(const QString &source, const QString mtype="");
+    // Returns source unchanged if the repair fails, ok (when given) tells which happened
+    static QString XMLPrettyPrintBS4(const QString &source, const QString mtype="", bool *ok = NULL);
 
     static QString PrettifyDOCTYPEHeader(const QString &source);
 
@@ -78,6 +80,12 @@ private:
      */
     static QString RemoveMetaCharset(const QString &source);
 
+    /**
+     * Native well-formed check used to avoid the python repair of
+     * xml that does not need it. False means "unknown, ask python".
+     */
+    static bool IsWellFormedXMLNative(const QString &source);
+
 };
 
 
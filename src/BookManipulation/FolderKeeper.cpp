@@ -505,6 +505,12 @@ QStringList FolderKeeper::GetAllBookPaths() const
 }
 
 
+ReferenceIndex *FolderKeeper::GetReferenceIndex()
+{
+    return &m_ReferenceIndex;
+}
+
+
 void FolderKeeper::RemoveResource(const Resource *resource)
 {
     m_Resources.remove(resource->GetIdentifier());
@@ -29,6 +29,7 @@
 #include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QMutex>
+#include <QtCore/QVector>
 #include <QFileSystemWatcher>
 
 // These have to be included directly because
@@ -206,6 +207,14 @@ public:
 
     QStringList GetAllBookPaths() const;
 
+    /**
+     * Returns the book wide index of which resources refer to
+     * which book paths. Refresh it before querying.
+     *
+     * @return The reference index.
+     */
+    ReferenceIndex *GetReferenceIndex();
+
     void updateShortPathNames();
 
     void PerformInitialLoads();
@@ -334,6 +343,8 @@ private:
 
     QHash<QString, QStringList> m_GrpToFold;
     QHash<QString, QStringList> m_StdGrpToFold;
+
+    ReferenceIndex m_ReferenceIndex;
 };
 
 
@@ -390,15 +401,28 @@ QList<T *> FolderKeeper::ListResourceSort(const QList<T *> &resource_list)  cons
 template<> inline
 QList<HTMLResource *> FolderKeeper::ListResourceSort<HTMLResource>(const QList<HTMLResource *> &resource_list) const
 {
-    QStringList spine_order_filenames = GetOPF()->GetSpineOrderBookPaths();
-    QList<HTMLResource *> htmls = resource_list;
+    const QHash<QString, int> spine_index = GetOPF()->GetSpinePositionIndex();
+    // Drop each file into its spine slot instead of searching the list
+    // for every spine entry.
+    int spine_length = 0;
+    foreach(int pos, spine_index) {
+        spine_length = qMax(spine_length, pos + 1);
+    }
+    QVector<HTMLResource *> spine_slots(spine_length, NULL);
+    QList<HTMLResource *> htmls;
+    foreach(HTMLResource *html_resource, resource_list) {
+        int pos = spine_index.value(html_resource->GetRelativePath(), -1);
+        if (pos > -1 && !spine_slots.at(pos)) {
+            spine_slots[ pos ] = html_resource;
+        } else {
+            htmls.append(html_resource);
+        }
+    }
     QList<HTMLResource *> sorted_htmls;
-    foreach(const QString & spine_filename, spine_order_filenames) {
-        for (int i = 0; i < htmls.count(); ++i) {
-            if (spine_filename == htmls[ i ]->GetRelativePath()) {
-                sorted_htmls.append(htmls.takeAt(i));
-                break;
-            }
+    sorted_htmls.reserve(resource_list.count());
+    foreach(HTMLResource *html_resource, spine_slots) {
+        if (html_resource) {
+            sorted_htmls.append(html_resource);
         }
     }
     // It's possible that there are certain HTML files in the
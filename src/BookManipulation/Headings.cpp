@@ -72,11 +72,20 @@ QList<Headings::Heading> Headings::GetHeadingListForOneFile(HTMLResource *html_r
         bool include_unwanted_headings)
 {
     Q_ASSERT(html_resource);
-    QString source = html_resource->GetText();
-    QString version = html_resource->GetEpubVersion();
-    GumboInterface gi = GumboInterface(source, version);
-    gi.parse();
+    // The resource keeps the full heading list cached per text revision
+    QList<Headings::Heading> headings;
+    foreach(Heading heading, html_resource->GetHeadings()) {
+        if (heading.include_in_toc || include_unwanted_headings) {
+            headings.append(heading);
+        }
+    }
+    return headings;
+}
+
 
+// Returns every heading in the parsed document, wanted or not
+QList<Headings::Heading> Headings::GetHeadingsInDocument(GumboInterface &gi, HTMLResource *html_resource)
+{
     // get original source line number of body element
     unsigned int body_line = 0;
     QList<GumboNode*> bodylist = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
@@ -132,9 +141,7 @@ QList<Headings::Heading> Headings::GetHeadingListForOneFile(HTMLResource *html_r
         heading.at_file_start = (i == 0) && ((node_line - body_line) < ALLOWED_HEADING_DISTANCE);
         heading.is_changed     = false;
 
-        if (heading.include_in_toc || include_unwanted_headings) {
-            headings.append(heading);
-        }
+        headings.append(heading);
     }
 
     return headings;
@@ -28,6 +28,7 @@
 #include <QtCore/QMetaType>
 
 
+class GumboInterface;
 class HTMLResource;
 class QString;
 
@@ -94,6 +95,10 @@ public:
     static QList<Heading> GetHeadingListForOneFile(HTMLResource *html_resource,
             bool include_unwanted_headings = false);
 
+    // Returns all headings (including unwanted ones) found in an already
+    // parsed document; used by HTMLResource to fill its heading cache
+    static QList<Heading> GetHeadingsInDocument(GumboInterface &gi, HTMLResource *html_resource);
+
     // Takes a flat list of headings and returns a list with those
     // headings sorted into a hierarchy
     static QList<Heading> MakeHeadingHeirarchy(const QList<Heading> &headings);
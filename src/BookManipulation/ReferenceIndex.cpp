@@ -0,0 +1,190 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QReadLocker>
+#include <QtCore/QUrl>
+#include <QtConcurrent/QtConcurrent>
+#include <QRegularExpression>
+
+#include "BookManipulation/ReferenceIndex.h"
+#include "Misc/GumboInterface.h"
+#include "Misc/Utility.h"
+#include "ResourceObjects/TextResource.h"
+#include "SourceUpdates/PerformCSSUpdates.h"
+
+static const QString NCX_SRC_PATTERN = "\\bsrc\\s*=\\s*[\"']([^\"']*)[\"']";
+
+
+ReferenceIndex::ReferenceIndex()
+{
+}
+
+
+void ReferenceIndex::Refresh(const QList<Resource *> &resources)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    QHash<QString, Resource *> current;
+    QList<Resource *> stale;
+    foreach(Resource *resource, resources) {
+        Resource::ResourceType type = resource->Type();
+        if ((type != Resource::HTMLResourceType) &&
+            (type != Resource::CSSResourceType) &&
+            (type != Resource::NCXResourceType)) {
+            continue;
+        }
+        QString identifier = resource->GetIdentifier();
+        current[identifier] = resource;
+        TextResource *text_resource = qobject_cast<TextResource *>(resource);
+        if (!m_Entries.contains(identifier) ||
+            (m_Entries.value(identifier).revision != text_resource->GetTextRevision()) ||
+            (m_Entries.value(identifier).bookpath != resource->GetCurrentBookRelPath())) {
+            stale.append(resource);
+        }
+    }
+
+    foreach(QString identifier, m_Entries.keys()) {
+        if (!current.contains(identifier)) {
+            RemoveEntry(identifier);
+        }
+    }
+    m_Resources = current;
+
+    const QList<Entry> entries = QtConcurrent::blockingMapped(stale, ScanResource);
+    foreach(const Entry &entry, entries) {
+        RemoveEntry(entry.identifier);
+        AddEntry(entry);
+    }
+}
+
+
+QSet<Resource *> ReferenceIndex::GetReferringResources(const QStringList &bookpaths)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    QSet<Resource *> referring;
+    foreach(QString bookpath, bookpaths) {
+        foreach(QString identifier, m_Referrers.value(bookpath)) {
+            Resource *resource = m_Resources.value(identifier);
+            if (resource) {
+                referring.insert(resource);
+            }
+        }
+    }
+    return referring;
+}
+
+
+ReferenceIndex::Entry ReferenceIndex::ScanResource(Resource *resource)
+{
+    TextResource *text_resource = qobject_cast<TextResource *>(resource);
+    QReadLocker locker(&resource->GetLock());
+    Entry entry;
+    entry.identifier = resource->GetIdentifier();
+    // read the revision before the text so a concurrent change
+    // can only ever leave us with an entry that is rescanned next time
+    entry.revision = text_resource->GetTextRevision();
+    entry.bookpath = resource->GetCurrentBookRelPath();
+    if (resource->Type() == Resource::HTMLResourceType) {
+        entry.targets = GetHTMLTargets(text_resource->GetUtf8Text(), entry.bookpath);
+    } else if (resource->Type() == Resource::CSSResourceType) {
+        entry.targets = PerformCSSUpdates::GetReferencedBookPaths(text_resource->GetText(), entry.bookpath);
+    } else {
+        entry.targets = GetNCXTargets(text_resource->GetText(), entry.bookpath);
+    }
+    entry.targets.removeDuplicates();
+    return entry;
+}
+
+
+QStringList ReferenceIndex::GetHTMLTargets(const QByteArray &source, const QString &bookpath)
+{
+    QStringList targets;
+    if (source.isEmpty()) {
+        return targets;
+    }
+    QStringList urls;
+    QStringList styles;
+    GumboInterface gi = GumboInterface(source, "any_version");
+    gi.parse();
+    gi.get_all_reference_values(urls, styles);
+    QString startdir = Utility::startingDir(bookpath);
+    foreach(QString url, urls) {
+        if (url.indexOf(':') != -1) {
+            continue;
+        }
+        // resolved the same way GumboInterface::update_attribute_value does
+        QString attpath = QUrl(url).path();
+        if (attpath.startsWith("./")) attpath = attpath.mid(2);
+        if (!attpath.isEmpty()) {
+            targets.append(Utility::buildBookPath(attpath, startdir));
+        }
+    }
+    foreach(QString style, styles) {
+        // a style attribute need not end its last property
+        targets.append(PerformCSSUpdates::GetReferencedBookPaths(style + ";", bookpath));
+    }
+    return targets;
+}
+
+
+QStringList ReferenceIndex::GetNCXTargets(const QString &source, const QString &bookpath)
+{
+    QStringList targets;
+    QString startdir = Utility::startingDir(bookpath);
+    QRegularExpression src_attribute(NCX_SRC_PATTERN);
+    QRegularExpressionMatchIterator mi = src_attribute.globalMatch(source);
+    while (mi.hasNext()) {
+        QString src = mi.next().captured(1);
+        if (src.indexOf(':') != -1) {
+            continue;
+        }
+        QString apath = Utility::URLDecodePath(src.left(src.indexOf('#')));
+        if (!apath.isEmpty()) {
+            targets.append(Utility::buildBookPath(apath, startdir));
+        }
+    }
+    return targets;
+}
+
+
+void ReferenceIndex::AddEntry(const Entry &entry)
+{
+    foreach(QString target, entry.targets) {
+        m_Referrers[target].insert(entry.identifier);
+    }
+    m_Entries[entry.identifier] = entry;
+}
+
+
+void ReferenceIndex::RemoveEntry(const QString &identifier)
+{
+    if (!m_Entries.contains(identifier)) {
+        return;
+    }
+    foreach(QString target, m_Entries.value(identifier).targets) {
+        QSet<QString> &referrers = m_Referrers[target];
+        referrers.remove(identifier);
+        if (referrers.isEmpty()) {
+            m_Referrers.remove(target);
+        }
+    }
+    m_Entries.remove(identifier);
+}
@@ -0,0 +1,113 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef REFERENCEINDEX_H
+#define REFERENCEINDEX_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class Resource;
+
+/**
+ * Book wide reverse index of references: for every book path it
+ * knows which resources refer to it (html href, src, poster and data
+ * attributes and style urls, css urls and the ncx src attributes).
+ *
+ * Each resource is only scanned again once its text revision or its
+ * book path has changed, so after the first use renaming, moving,
+ * splitting or merging files only has to look at the resources that
+ * really refer to the paths involved.
+ */
+class ReferenceIndex
+{
+
+public:
+    ReferenceIndex();
+
+    /**
+     * Brings the index up to date with the given resources.
+     * Stale resources are rescanned in parallel, resources no
+     * longer present are dropped.
+     *
+     * @param resources All the resources of the book.
+     */
+    void Refresh(const QList<Resource *> &resources);
+
+    /**
+     * Returns the resources that refer to any of the given book paths
+     * as of the last Refresh().
+     *
+     * @param bookpaths The book paths to look for.
+     * @return The referring resources.
+     */
+    QSet<Resource *> GetReferringResources(const QStringList &bookpaths);
+
+private:
+    struct Entry {
+        QString identifier;
+        int revision;
+        QString bookpath;
+        QStringList targets;
+    };
+
+    /**
+     * Scans one resource for the book paths it refers to. Book paths
+     * are resolved from where the resource was when its text was
+     * written, which differs from its current one until a move is
+     * followed by the universal updates.
+     */
+    static Entry ScanResource(Resource *resource);
+
+    static QStringList GetHTMLTargets(const QByteArray &source, const QString &bookpath);
+
+    static QStringList GetNCXTargets(const QString &source, const QString &bookpath);
+
+    void AddEntry(const Entry &entry);
+
+    void RemoveEntry(const QString &identifier);
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    /**
+     * The indexed resources by identifier, and what they refer to.
+     */
+    QHash<QString, Entry> m_Entries;
+    QHash<QString, Resource *> m_Resources;
+
+    /**
+     * The reverse index, book path to identifiers of the
+     * resources referring to it.
+     */
+    QHash<QString, QSet<QString> > m_Referrers;
+
+    QMutex m_AccessMutex;
+};
+
+#endif // REFERENCEINDEX_H
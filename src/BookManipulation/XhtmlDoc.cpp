@@ -228,14 +228,13 @@ QList<QString> XhtmlDoc::GetAllDescendantIDs(const QString & source)
     nodes.append(gi.get_all_nodes_with_attribute(QString("name")));
     QStringList IDs;
     foreach(GumboNode * node, nodes) {
-        QString element_name = QString::fromStdString(gi.get_tag_name(node));
         GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "id");
         if (attr) {
             IDs.append(QString::fromUtf8(attr->value));
         } else {
             // This is supporting legacy html of <a name="xxx"> (deprecated).
             // Make sure we don't return names of other elements like <meta> tags.
-          if (element_name == "a") {
+          if (gi.get_tag_name_view(node) == "a") {
                 attr = gumbo_get_attribute(&node->v.element.attributes, "name");
                 if (attr) {
                     IDs.append(QString::fromUtf8(attr->value));
@@ -253,7 +252,6 @@ QList<QString> XhtmlDoc::GetAllDescendantHrefs(const QString & source)
     QList<GumboNode*> nodes = gi.get_all_nodes_with_attribute(QString("href"));
     QStringList hrefs;
     foreach(GumboNode * node, nodes) {
-        QString element_name = QString::fromStdString(gi.get_tag_name(node));
         GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "href");
         if (attr) {
             hrefs.append(QString::fromUtf8(attr->value));
@@ -262,6 +260,89 @@ QList<QString> XhtmlDoc::GetAllDescendantHrefs(const QString & source)
     return hrefs;
 }
 
+// Gathers ids, hrefs, style urls, classes and media paths in one walk
+// of the tree. The results match the separate GetAllDescendant* and
+// GetAllMediaPathsFromMediaChildren routines, including their ordering.
+void XhtmlDoc::CollectDocumentFacts(GumboInterface &gi, DocumentFacts &facts)
+{
+    GumboNode *root = gi.get_root_node();
+    if (!root) {
+        return;
+    }
+    // legacy <a name="xxx"> ids always come after the real ids
+    QStringList name_ids;
+    CollectNodeFacts(gi, root, facts, name_ids);
+    facts.ids.append(name_ids);
+}
+
+
+void XhtmlDoc::CollectNodeFacts(GumboInterface &gi, GumboNode *node, DocumentFacts &facts, QStringList &name_ids)
+{
+    static const QRegularExpression url_search(URL_ATTRIBUTE_SEARCH);
+
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return;
+    }
+    const GumboVector *attributes = &node->v.element.attributes;
+    GumboAttribute *id_attr = gumbo_get_attribute(attributes, "id");
+    if (id_attr) {
+        facts.ids.append(QString::fromUtf8(id_attr->value));
+    }
+    GumboAttribute *attr = gumbo_get_attribute(attributes, "name");
+    if (attr) {
+        if (id_attr) {
+            name_ids.append(QString::fromUtf8(id_attr->value));
+        } else if (node->v.element.tag == GUMBO_TAG_A) {
+            name_ids.append(QString::fromUtf8(attr->value));
+        }
+    }
+    attr = gumbo_get_attribute(attributes, "href");
+    if (attr) {
+        facts.hrefs.append(QString::fromUtf8(attr->value));
+    }
+    attr = gumbo_get_attribute(attributes, "style");
+    if (attr) {
+        QRegularExpressionMatch match = url_search.match(QString::fromUtf8(attr->value));
+        if (match.hasMatch()) {
+            facts.style_urls.append(match.captured(1));
+        }
+    }
+    attr = gumbo_get_attribute(attributes, "class");
+    if (attr) {
+        QString element_name = QString::fromStdString(gi.get_tag_name(node));
+        foreach(QString class_name, QString::fromUtf8(attr->value).split(" ")) {
+            facts.classes.append(element_name + "." + class_name);
+        }
+    }
+    GumboTag tag = node->v.element.tag;
+    bool is_image = GIMAGE_TAGS.contains(tag);
+    bool is_video = GVIDEO_TAGS.contains(tag);
+    bool is_audio = GAUDIO_TAGS.contains(tag);
+    if (is_image || is_video || is_audio) {
+        attr = gumbo_get_attribute(attributes, "src");
+        if (!attr) {
+            // search for xlink:href using gumbo attribute namespace
+            attr = gumbo_get_attribute(attributes, "href");
+            if (attr && attr->attr_namespace != GUMBO_ATTR_NAMESPACE_XLINK) attr = NULL;
+        }
+        if (attr) {
+            QString relative_path = QString::fromUtf8(attr->value);
+            if (relative_path.indexOf(":") == -1) {
+                QString apath = Utility::parseRelativeHREF(relative_path).first;
+                facts.media_paths << apath;
+                if (is_image) facts.image_paths << apath;
+                if (is_video) facts.video_paths << apath;
+                if (is_audio) facts.audio_paths << apath;
+            }
+        }
+    }
+    GumboVector *children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        CollectNodeFacts(gi, static_cast<GumboNode*>(children->data[i]), facts, name_ids);
+    }
+}
+
+
 XhtmlDoc::WellFormedError XhtmlDoc::GumboWellFormedErrorForSource(const QString &source, QString version)
 {
     GumboInterface gi = GumboInterface(source, version);
@@ -464,7 +545,7 @@ QList<GumboNode *> XhtmlDoc::GetVisibleTextNodes(GumboInterface &gi, GumboNode *
     } else if ((node->type == GUMBO_NODE_CDATA) || (node->type == GUMBO_NODE_COMMENT)) {
         return QList<GumboNode*>();
     } else {
-        QString node_name = QString::fromStdString(gi.get_tag_name(node));
+        QByteArray node_name = gi.get_tag_name_view(node);
         GumboVector* children = &node->v.element.children;
         if ((children->length > 0)  && (node_name != "script") && (node_name != "style")) {
             QList<GumboNode *> text_nodes;
@@ -528,11 +609,12 @@ QString XhtmlDoc::GetIDElementText(GumboInterface &gi, GumboNode *node)
         return text;
     }
     GumboVector* children = &node->v.element.children;
+    // the name checked is that of node itself so only look it up once
+    QString child_node_name = QString::fromUtf8(gi.get_tag_name_view(node));
 
     // Combine all text nodes for this node plus all text for non-ID element children
     for (unsigned int i = 0; i < children->length; ++i) {
         GumboNode* child_node = static_cast<GumboNode*>(children->data[i]);
-        QString child_node_name = QString::fromStdString(gi.get_tag_name(node));
         if ((child_node->type == GUMBO_NODE_TEXT) || (child_node->type == GUMBO_NODE_WHITESPACE)) {
             text += QString::fromUtf8(child_node->v.text.text);
         } else if (!ID_TAGS.contains(child_node_name)) {
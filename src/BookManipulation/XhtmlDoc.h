@@ -86,6 +86,27 @@ public:
         WellFormedError() : line(-1), column(-1) {}
     };
 
+    // Everything the Book and report queries want to know about one
+    // xhtml document, gathered with a single gumbo walk.
+    // The path lists hold the raw (url encoded) relative paths with any
+    // fragment removed, exactly as GetAllMediaPathsFromMediaChildren does.
+    struct DocumentFacts {
+        QStringList ids;
+        QStringList hrefs;
+        QStringList style_urls;
+        QStringList classes;
+        QStringList image_paths;
+        QStringList video_paths;
+        QStringList audio_paths;
+        QStringList media_paths;
+        QStringList linked_stylesheets;
+    };
+
+    // Fills in the gumbo derived fields of facts from an already parsed tree.
+    // The linked_stylesheets field is left untouched since it is taken
+    // from the head with the xml reader (see GetLinkedStylesheets).
+    static void CollectDocumentFacts(GumboInterface &gi, DocumentFacts &facts);
+
     static WellFormedError GumboWellFormedErrorForSource(const QString &source, QString version="2.0");
 
     static WellFormedError WellFormedErrorForSource(const QString &source, QString version="2.0");
@@ -154,6 +175,8 @@ private:
     // Returns an XMLElement struct with the data in the stream.
     static XMLElement CreateXMLElement(QXmlStreamReader &reader);
 
+    static void CollectNodeFacts(GumboInterface &gi, GumboNode *node, DocumentFacts &facts, QStringList &name_ids);
+
 };
 
 #endif // XHTMLDOC_H
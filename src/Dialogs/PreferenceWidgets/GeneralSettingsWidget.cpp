@@ -29,6 +29,7 @@
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QStandardPaths>
+#include <QThread>
 
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
@@ -109,6 +110,7 @@ PreferencesWidget::ResultActions GeneralSettingsWidget::saveSettings()
     settings.setRemoteOn(new_remote_on_level);
     settings.setJavascriptOn(new_javascript_on_level);
     settings.setClipboardHistoryLimit(int(ui.clipLimitSpin->value()));
+    settings.setPythonWorkerCount(int(ui.pythonWorkerSpin->value()));
     settings.setTempFolderHome(new_temp_folder_home);
     settings.setExternalXEditorPath(new_xeditor_path);
 
@@ -141,6 +143,11 @@ void GeneralSettingsWidget::readSettings()
     int javascriptOn = settings.javascriptOn();
     ui.AllowJavascript->setChecked(javascriptOn);
     ui.clipLimitSpin->setValue(int(settings.clipboardHistoryLimit()));
+    int python_workers = settings.pythonWorkerCount();
+    if ((python_workers < 0) || (python_workers > QThread::idealThreadCount())) {
+        python_workers = QThread::idealThreadCount();
+    }
+    ui.pythonWorkerSpin->setValue(python_workers);
     QString temp_folder_home = settings.tempFolderHome();
     ui.lineEdit->setText(temp_folder_home);
     QString xeditor_path = settings.externalXEditorPath();
@@ -246,6 +253,9 @@ void GeneralSettingsWidget::ExtendUI() {
     // Make sure no one can enter anything other than 0 - CLIPBOARD_HISTORY_MAX
     ui.clipLimitSpin->setMinimum(0);
     ui.clipLimitSpin->setMaximum(CLIPBOARD_HISTORY_MAX);
+    // No point in more helpers than cores
+    ui.pythonWorkerSpin->setMinimum(0);
+    ui.pythonWorkerSpin->setMaximum(QThread::idealThreadCount());
 }
 
 void GeneralSettingsWidget::connectSignalsToSlots()
@@ -26,19 +26,26 @@
 
 #include <string>
 #include <string.h>
+#include <stdio.h>
 
 #include <zip.h>
+#include <unzip.h>
 #ifdef _WIN32
 #include <iowin32.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
 #endif
 
+#include <QtCore/QBuffer>
 #include <QtCore/QDateTime>
 #include <QtCore/QDir>
 #include <QtCore/QDirIterator>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QTemporaryFile>
-#include <QtCore/QTextStream>
+#include <QtConcurrent/QtConcurrent>
 
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/FolderKeeper.h"
@@ -52,7 +59,7 @@
 #include "sigil_constants.h"
 #include "sigil_exception.h"
 
-#define BUFF_SIZE 8192
+#define BUFF_SIZE 65536
 
 const QString BODY_START = "<\\s*body[^>]*>";
 const QString BODY_END   = "</\\s*body\\s*>";
@@ -60,11 +67,319 @@ const QString BODY_END   = "</\\s*body\\s*>";
 const QString CONTAINER_XML_FILE_NAME  = "container.xml";
 const QString ENCRYPTION_XML_FILE_NAME = "encryption.xml";
 
-static const QString METAINF_FOLDER_SUFFIX = "/META-INF";
+static const QString ENCRYPTION_XML_BOOKPATH = "META-INF/" + ENCRYPTION_XML_FILE_NAME;
+
+#ifndef _WIN32
+// The umask can only be read by setting it, which would briefly affect
+// every thread creating files. Read it once during static initialization,
+// before main() has started any other thread.
+static mode_t ReadFileCreationMask()
+{
+    mode_t mask = ::umask(0);
+    ::umask(mask);
+    return mask;
+}
+
+static const mode_t FILE_CREATION_MASK = ReadFileCreationMask();
+#endif
 
 static const char * EPUB_MIME_DATA = "application/epub+zip";
 
 
+// Inputs are deflated in independent blocks of this size
+// so large files are spread over the thread pool too
+static const qint64 DEFLATE_BLOCK_SIZE = 1024 * 1024;
+
+// How far back deflate can reach, a block is primed with
+// this much of the preceding input to keep the ratio up
+static const int DEFLATE_DICT_SIZE = 32768;
+
+// Upper bound on the input compressed per round, this
+// bounds the memory held by compressed blocks
+static const qint64 DEFLATE_BATCH_SIZE = 64 * 1024 * 1024;
+
+static const int DEFLATE_LEVEL = 8;
+
+
+// One file destined for the archive, read from disk
+// unless its (already transformed) data is in memory.
+// When the epub we came from holds the very same content
+// the entry is copied from there still compressed.
+struct ZipEntry {
+    QString relpath;
+    QString filepath;
+    QByteArray data;
+    qint64 size;
+
+    bool has_cached;
+    ZipEntryCache::Entry cached;
+    bool reuse;
+};
+
+
+// A slice of an entry and, once deflated, its raw deflate
+// data and crc. Every block but the entry's last ends on a
+// byte boundary (sync flush) so blocks can be concatenated.
+struct DeflateBlock {
+    int entry;
+    bool copy;
+    QString filepath;
+    QByteArray data;
+    qint64 offset;
+    qint64 length;
+    bool last;
+
+    QByteArray compressed;
+    uLong crc;
+    bool ok;
+};
+
+
+// An entry is reused when its content has the size
+// and crc recorded for it in the source archive
+static void VerifyCachedEntry(ZipEntry &entry)
+{
+    entry.reuse = false;
+
+    if (!entry.has_cached || (entry.cached.uncompressed_size != entry.size)) {
+        return;
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+
+    if (entry.filepath.isEmpty()) {
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(entry.data.constData()), (uInt)entry.data.size());
+    } else {
+        QFile file(entry.filepath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return;
+        }
+
+        QByteArray buff(BUFF_SIZE, 0);
+        qint64 read = 0;
+        qint64 total = 0;
+
+        while ((read = file.read(buff.data(), BUFF_SIZE)) > 0) {
+            crc = crc32(crc, reinterpret_cast<const Bytef *>(buff.constData()), (uInt)read);
+            total += read;
+        }
+
+        if ((read < 0) || (total != entry.size)) {
+            return;
+        }
+    }
+
+    entry.reuse = ((quint32)crc == entry.cached.crc);
+}
+
+
+static void DeflateOneBlock(DeflateBlock &block)
+{
+    block.ok = false;
+
+    if (block.copy) {
+        // copied raw from the source archive when written out
+        block.ok = true;
+        return;
+    }
+
+    qint64 dict_start = qMax<qint64>(0, block.offset - DEFLATE_DICT_SIZE);
+    qint64 dict_length = block.offset - dict_start;
+    QByteArray input;
+
+    if (block.filepath.isEmpty()) {
+        input = block.data.mid(dict_start, dict_length + block.length);
+    } else {
+        // every block uses its own handle so blocks of one file are read in parallel
+        QFile file(block.filepath);
+        if (!file.open(QIODevice::ReadOnly) || !file.seek(dict_start)) {
+            return;
+        }
+        input = file.read(dict_length + block.length);
+    }
+
+    if (input.size() != dict_length + block.length) {
+        return;
+    }
+
+    const Bytef *dict = reinterpret_cast<const Bytef *>(input.constData());
+    const Bytef *in = dict + dict_length;
+    block.crc = crc32(crc32(0L, Z_NULL, 0), in, (uInt)block.length);
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (deflateInit2(&strm, DEFLATE_LEVEL, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    if ((dict_length > 0) && (deflateSetDictionary(&strm, dict, (uInt)dict_length) != Z_OK)) {
+        deflateEnd(&strm);
+        return;
+    }
+
+    int flush = block.last ? Z_FINISH : Z_SYNC_FLUSH;
+    QByteArray &out = block.compressed;
+    out.resize(deflateBound(&strm, (uLong)block.length) + 64);
+    strm.next_in = const_cast<Bytef *>(in);
+    strm.avail_in = (uInt)block.length;
+    strm.next_out = reinterpret_cast<Bytef *>(out.data());
+    strm.avail_out = (uInt)out.size();
+
+    int ret;
+    while (true) {
+        ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR) {
+            break;
+        }
+        if (block.last ? (ret == Z_STREAM_END) : ((strm.avail_in == 0) && (strm.avail_out > 0))) {
+            break;
+        }
+        // out of room, grow the buffer and carry on
+        int used = out.size() - strm.avail_out;
+        out.resize(out.size() * 2);
+        strm.next_out = reinterpret_cast<Bytef *>(out.data()) + used;
+        strm.avail_out = (uInt)(out.size() - used);
+    }
+    out.resize(out.size() - strm.avail_out);
+    deflateEnd(&strm);
+    block.ok = (ret != Z_STREAM_ERROR);
+}
+
+
+// Opens a new deflated entry whose data we deflate ourselves
+static void OpenRawEntryInZip(zipFile zfile, const ZipEntry &entry, const zip_fileinfo *fileInfo)
+{
+    int zip64 = (entry.size >= 0xffffffff) ? 1 : 0;
+    if (zipOpenNewFileInZip4_64(zfile, entry.relpath.toUtf8().constData(), fileInfo, NULL, 0, NULL, 0, NULL, Z_DEFLATED, DEFLATE_LEVEL, 1, 15, 8, Z_DEFAULT_STRATEGY, NULL, 0, 0x0b00, 1<<11, zip64) != ZIP_OK) {
+        throw(CannotStoreFile(entry.relpath.toStdString()));
+    }
+}
+
+
+// Copies an entry from the source archive as it is, without inflating it
+static void CopyRawEntryToZip(unzFile source, zipFile zfile, const ZipEntry &entry, const zip_fileinfo *fileInfo)
+{
+    unz64_file_pos file_pos;
+    file_pos.pos_in_zip_directory = entry.cached.pos_in_zip_directory;
+    file_pos.num_of_file = entry.cached.num_of_file;
+    int method = 0;
+    int level = 0;
+
+    if ((unzGoToFilePos64(source, &file_pos) != UNZ_OK) ||
+        (unzOpenCurrentFile2(source, &method, &level, 1) != UNZ_OK)) {
+        throw(CannotStoreFile(entry.relpath.toStdString()));
+    }
+
+    int zip64 = ((entry.size >= 0xffffffff) || (entry.cached.compressed_size >= 0xffffffff)) ? 1 : 0;
+    if (zipOpenNewFileInZip4_64(zfile, entry.relpath.toUtf8().constData(), fileInfo, NULL, 0, NULL, 0, NULL, method, level, 1, 15, 8, Z_DEFAULT_STRATEGY, NULL, 0, 0x0b00, 1<<11, zip64) != ZIP_OK) {
+        unzCloseCurrentFile(source);
+        throw(CannotStoreFile(entry.relpath.toStdString()));
+    }
+
+    QByteArray buff(BUFF_SIZE, 0);
+    int read = 0;
+    qint64 total = 0;
+
+    while ((read = unzReadCurrentFile(source, buff.data(), BUFF_SIZE)) > 0) {
+        if (zipWriteInFileInZip(zfile, buff.constData(), (unsigned int)read) != ZIP_OK) {
+            unzCloseCurrentFile(source);
+            throw(CannotStoreFile(entry.relpath.toStdString()));
+        }
+        total += read;
+    }
+
+    unzCloseCurrentFile(source);
+
+    if ((read < 0) || (total != entry.cached.compressed_size)) {
+        throw(CannotStoreFile(entry.relpath.toStdString()));
+    }
+
+    if (zipCloseFileInZipRaw64(zfile, (ZPOS64_T)entry.size, (uLong)entry.cached.crc) != ZIP_OK) {
+        throw(CannotStoreFile(entry.relpath.toStdString()));
+    }
+}
+
+
+static unzFile OpenSourceArchive(const QString &archive_path)
+{
+#ifdef Q_OS_WIN32
+    zlib_filefunc64_def ffunc;
+    fill_win32_filefunc64W(&ffunc);
+    return unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(archive_path)).c_str(), &ffunc);
+#else
+    return unzOpen64(QDir::toNativeSeparators(archive_path).toUtf8().constData());
+#endif
+}
+
+
+// Deflates the entries on the thread pool a batch at a
+// time and appends them to the archive in their original order
+static void AddEntriesToZip(zipFile zfile, unzFile source, const QList<ZipEntry> &entries, const zip_fileinfo *fileInfo)
+{
+    int entry_index = 0;
+    qint64 entry_offset = 0;
+    uLong entry_crc = 0;
+
+    while (entry_index < entries.count()) {
+        QList<DeflateBlock> blocks;
+        qint64 batch_size = 0;
+
+        while ((entry_index < entries.count()) && (batch_size < DEFLATE_BATCH_SIZE)) {
+            const ZipEntry &entry = entries.at(entry_index);
+            DeflateBlock block;
+            block.entry = entry_index;
+            block.copy = entry.reuse;
+            block.filepath = entry.filepath;
+            block.data = entry.data;
+            block.offset = entry_offset;
+            block.length = block.copy ? entry.size : qMin(DEFLATE_BLOCK_SIZE, entry.size - entry_offset);
+            block.last = (entry_offset + block.length) >= entry.size;
+            block.crc = 0;
+            block.ok = false;
+            blocks.append(block);
+            batch_size += (block.copy ? 0 : block.length) + 1;
+
+            if (block.last) {
+                entry_index++;
+                entry_offset = 0;
+            } else {
+                entry_offset += block.length;
+            }
+        }
+
+        QtConcurrent::blockingMap(blocks, DeflateOneBlock);
+
+        foreach(const DeflateBlock &block, blocks) {
+            const ZipEntry &entry = entries.at(block.entry);
+
+            if (!block.ok) {
+                throw(CannotStoreFile(entry.relpath.toStdString()));
+            }
+
+            if (block.copy) {
+                CopyRawEntryToZip(source, zfile, entry, fileInfo);
+                continue;
+            }
+
+            if (block.offset == 0) {
+                OpenRawEntryInZip(zfile, entry, fileInfo);
+                entry_crc = block.crc;
+            } else {
+                entry_crc = crc32_combine(entry_crc, block.crc, (z_off_t)block.length);
+            }
+
+            if (!block.compressed.isEmpty() &&
+                (zipWriteInFileInZip(zfile, block.compressed.constData(), (unsigned int)block.compressed.size()) != ZIP_OK)) {
+                throw(CannotStoreFile(entry.relpath.toStdString()));
+            }
+
+            if (block.last && (zipCloseFileInZipRaw64(zfile, (ZPOS64_T)entry.size, entry_crc) != ZIP_OK)) {
+                throw(CannotStoreFile(entry.relpath.toStdString()));
+            }
+        }
+    }
+}
+
+
 // Constructor;
 // the first parameter is the location where the book
 // should be save to, and the second is the book to be saved
@@ -94,43 +409,46 @@ void ExportEPUB::WriteBook()
     m_Book->GetOPF()->AddSigilVersionMeta();
     m_Book->GetOPF()->AddModificationDateMeta();
     m_Book->SaveAllResourcesToDisk();
-    TempFolder tempfolder;
-    CreatePublication(tempfolder.GetPath());
 
-    if (m_Book->HasObfuscatedFonts()) {
-        ObfuscateFonts(tempfolder.GetPath());
-    }
+    // Build the archive next to the destination so it can simply be
+    // moved into place. If that folder is not writable fall back
+    // to the scratchpad and copy the result over at the end.
+    QTemporaryFile tempfile(QFileInfo(m_FullFilePath).absolutePath() + "/.sigil-XXXXXX.epub");
 
-    SaveFolderAsEpubToLocation(tempfolder.GetPath(), m_FullFilePath);
-}
+    if (!tempfile.open()) {
+        tempfile.setFileTemplate(TempFolder::GetPathToSigilScratchpad() + "/book-XXXXXX.epub");
+        if (!tempfile.open()) {
+            throw(CannotWriteFile(m_FullFilePath.toStdString()));
+        }
+    }
 
+    QString tempfilepath = tempfile.fileName();
+    tempfile.setAutoRemove(false);
+    tempfile.close();
 
-// Creates the publication from the Book
-// (creates XHTML, CSS, OPF, NCX files etc.)
-void ExportEPUB::CreatePublication(const QString &fullfolderpath)
-{
-    Utility::CopyFiles(m_Book->GetFolderKeeper()->GetFullPathToMainFolder(), fullfolderpath);
+    SaveFolderAsEpubToLocation(m_Book->GetFolderKeeper()->GetFullPathToMainFolder(), tempfilepath);
+    CommitEpubToLocation(tempfilepath, m_FullFilePath);
 
-    if (m_Book->HasObfuscatedFonts()) {
-        CreateEncryptionXML(fullfolderpath + METAINF_FOLDER_SUFFIX);
-    }
+    // The new epub is where unchanged files come from next time
+    m_Book->GetZipEntryCache().Record(m_FullFilePath);
 }
 
+
 void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath)
 {
-    QString tempFile = fullfolderpath + "-tmp.epub";
     QDateTime timeNow = QDateTime::currentDateTime();
     zip_fileinfo fileInfo;
 #ifdef Q_OS_WIN32
     zlib_filefunc64_def ffunc;
     fill_win32_filefunc64W(&ffunc);
-    zipFile zfile = zipOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(tempFile)).c_str(), APPEND_STATUS_CREATE, NULL, &ffunc);
+    zipFile zfile = zipOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(fullfilepath)).c_str(), APPEND_STATUS_CREATE, NULL, &ffunc);
 #else
-    zipFile zfile = zipOpen64(QDir::toNativeSeparators(tempFile).toUtf8().constData(), APPEND_STATUS_CREATE);
+    zipFile zfile = zipOpen64(QDir::toNativeSeparators(fullfilepath).toUtf8().constData(), APPEND_STATUS_CREATE);
 #endif
 
     if (zfile == NULL) {
-        throw (CannotOpenFile(tempFile.toStdString()));
+        QFile::remove(fullfilepath);
+        throw (CannotOpenFile(fullfilepath.toStdString()));
     }
 
     memset(&fileInfo, 0, sizeof(fileInfo));
@@ -141,111 +459,195 @@ void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const
     fileInfo.tmz_date.tm_mon = timeNow.date().month() - 1;
     fileInfo.tmz_date.tm_year = timeNow.date().year();
 
-    // Write the mimetype. This must be uncompressed and the first entry in the archive.
-    if (zipOpenNewFileInZip64(zfile, "mimetype", &fileInfo, NULL, 0, NULL, 0, NULL, Z_NO_COMPRESSION, 0, 0) != ZIP_OK) {
-        zipClose(zfile, NULL);
-        QFile::remove(tempFile);
-        throw(CannotStoreFile("mimetype"));
-    }
+    // the epub the book was read from or last saved to
+    unzFile source = NULL;
 
-    if (zipWriteInFileInZip(zfile, EPUB_MIME_DATA, (unsigned int)strlen(EPUB_MIME_DATA)) != ZIP_OK) {
-        zipCloseFileInZip(zfile);
-        zipClose(zfile, NULL);
-        QFile::remove(tempFile);
-        throw(CannotStoreFile("mimetype"));
-    }
+    try {
+        // Write the mimetype. This must be uncompressed and the first entry in the archive.
+        if (zipOpenNewFileInZip64(zfile, "mimetype", &fileInfo, NULL, 0, NULL, 0, NULL, Z_NO_COMPRESSION, 0, 0) != ZIP_OK) {
+            throw(CannotStoreFile("mimetype"));
+        }
 
-    zipCloseFileInZip(zfile);
-    // Write all the files in our directory path to the archive.
-    QDirIterator it(fullfolderpath, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::Hidden, QDirIterator::Subdirectories);
+        if (zipWriteInFileInZip(zfile, EPUB_MIME_DATA, (unsigned int)strlen(EPUB_MIME_DATA)) != ZIP_OK) {
+            zipCloseFileInZip(zfile);
+            throw(CannotStoreFile("mimetype"));
+        }
 
-    while (it.hasNext()) {
-        it.next();
-        QString relpath = it.filePath().remove(fullfolderpath);
+        zipCloseFileInZip(zfile);
 
-        while (relpath.startsWith("/")) {
-            relpath = relpath.remove(0, 1);
+        // The encryption.xml is always generated fresh and fonts are
+        // obfuscated in memory, the book folder itself is never touched.
+        QList<ZipEntry> entries;
+        QHash<QString, std::pair<QString, QString> > obfuscations;
+        if (m_Book->HasObfuscatedFonts()) {
+            obfuscations = GetFontObfuscations();
+            ZipEntry entry;
+            entry.has_cached = false;
+            entry.reuse = false;
+            entry.relpath = ENCRYPTION_XML_BOOKPATH;
+            entry.data = CreateEncryptionXML();
+            entry.size = entry.data.size();
+            entries.append(entry);
         }
 
-        // Add the file entry to the archive.
-        // We should check the uncompressed file size. If it's over >= 0xffffffff the last parameter (zip64) should be 1.
-        if (zipOpenNewFileInZip4_64(zfile, relpath.toUtf8().constData(), &fileInfo, NULL, 0, NULL, 0, NULL, Z_DEFLATED, 8, 0, 15, 8, Z_DEFAULT_STRATEGY, NULL, 0, 0x0b00, 1<<11, 0) != ZIP_OK) {
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
-        }
+        // Collect all the files in our directory path for the archive.
+        QDirIterator it(fullfolderpath, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::Hidden, QDirIterator::Subdirectories);
 
-        // Open the file on disk. We will read this and write what we read into
-        // the archive.
-        QFile dfile(it.filePath());
+        while (it.hasNext()) {
+            it.next();
+            QString relpath = it.filePath().remove(fullfolderpath);
 
-        if (!dfile.open(QIODevice::ReadOnly)) {
-            zipCloseFileInZip(zfile);
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotOpenFile(it.fileName().toStdString()));
-        }
+            while (relpath.startsWith("/")) {
+                relpath = relpath.remove(0, 1);
+            }
 
-        // Write the data from the file on disk into the archive.
-        char buff[BUFF_SIZE] = {0};
-        qint64 read = 0;
+            if (!obfuscations.isEmpty() && (relpath == ENCRYPTION_XML_BOOKPATH)) {
+                continue;
+            }
+
+            ZipEntry entry;
+            entry.has_cached = false;
+            entry.reuse = false;
+            entry.relpath = relpath;
 
-        while ((read = dfile.read(buff, BUFF_SIZE)) > 0) {
-            if (zipWriteInFileInZip(zfile, buff, read) != ZIP_OK) {
-                dfile.close();
-                zipCloseFileInZip(zfile);
-                zipClose(zfile, NULL);
-                QFile::remove(tempFile);
-                throw(CannotStoreFile(relpath.toStdString()));
+            if (obfuscations.contains(relpath)) {
+                QFile font_file(it.filePath());
+
+                if (!font_file.open(QIODevice::ReadOnly)) {
+                    throw(CannotOpenFile(it.fileName().toStdString()));
+                }
+
+                std::pair<QString, QString> obfuscation = obfuscations.value(relpath);
+                entry.data = FontObfuscation::ObfuscateData(font_file.readAll(), obfuscation.first, obfuscation.second);
+                entry.size = entry.data.size();
+            } else {
+                entry.filepath = it.filePath();
+                entry.size = it.fileInfo().size();
             }
+            entries.append(entry);
         }
 
-        dfile.close();
+        // Find out which entries can be copied from the epub we came from
+        ZipEntryCache &cache = m_Book->GetZipEntryCache();
+        QString source_path = cache.GetArchivePath();
+        bool any_reuse = false;
 
-        // There was an error reading the file on disk.
-        if (read < 0) {
-            zipCloseFileInZip(zfile);
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
+        if (!source_path.isEmpty()) {
+            for (int i = 0; i < entries.count(); ++i) {
+                entries[i].has_cached = cache.Find(entries.at(i).relpath, entries[i].cached);
+            }
+            QtConcurrent::blockingMap(entries, VerifyCachedEntry);
+            foreach(const ZipEntry &entry, entries) {
+                any_reuse = any_reuse || entry.reuse;
+            }
         }
 
-        if (zipCloseFileInZip(zfile) != ZIP_OK) {
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
+        if (any_reuse) {
+            source = OpenSourceArchive(source_path);
+            if (source == NULL) {
+                for (int i = 0; i < entries.count(); ++i) {
+                    entries[i].reuse = false;
+                }
+            }
+        }
+
+        AddEntriesToZip(zfile, source, entries, &fileInfo);
+    } catch (...) {
+        if (source != NULL) {
+            unzClose(source);
         }
+        zipClose(zfile, NULL);
+        QFile::remove(fullfilepath);
+        throw;
+    }
+
+    if (source != NULL) {
+        unzClose(source);
+    }
+
+    if (zipClose(zfile, NULL) != ZIP_OK) {
+        QFile::remove(fullfilepath);
+        throw(CannotWriteFile(fullfilepath.toStdString()));
+    }
+}
+
+
+void ExportEPUB::CommitEpubToLocation(const QString &tempfilepath, const QString &fullfilepath)
+{
+#ifndef Q_OS_MAC
+    QFileInfo target(fullfilepath);
+    // Renaming over a symlink or a hard linked file would replace the
+    // link itself, so those get their contents overwritten below instead
+    bool is_link = target.isSymLink();
+#ifndef Q_OS_WIN32
+    struct stat target_stat;
+    if ((::stat(QFile::encodeName(fullfilepath).constData(), &target_stat) == 0) && (target_stat.st_nlink > 1)) {
+        is_link = true;
+    }
+#endif
+
+    if (target.exists()) {
+        // Keep the permissions of the book we are replacing
+        QFile::setPermissions(tempfilepath, QFile::permissions(fullfilepath));
+    } else {
+#ifndef Q_OS_WIN32
+        // The temp file was created private to us, a new book gets
+        // the permissions any newly created file would get
+        ::chmod(QFile::encodeName(tempfilepath).constData(), 0666 & ~FILE_CREATION_MASK);
+#endif
+    }
+
+    // Swap the finished archive in with a single rename so a failed
+    // save never leaves a truncated book behind.
+    bool renamed = false;
+    if (!is_link) {
+#ifdef Q_OS_WIN32
+        renamed = MoveFileExW(Utility::QStringToStdWString(QDir::toNativeSeparators(tempfilepath)).c_str(),
+                              Utility::QStringToStdWString(QDir::toNativeSeparators(fullfilepath)).c_str(),
+                              MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+        renamed = ::rename(QFile::encodeName(tempfilepath).constData(),
+                           QFile::encodeName(fullfilepath).constData()) == 0;
+#endif
+    }
+
+    if (renamed) {
+        return;
     }
+#endif
 
-    zipClose(zfile, NULL);
     // Overwrite the contents of the real file with the contents from the temp
-    // file we saved the data do. We do this instead of simply copying the file
-    // because a file copy will lose extended attributes such as labels on OS X.
-    QFile temp_epub(tempFile);
+    // file we saved the data do. We do this instead of simply moving the file
+    // because that would lose extended attributes such as labels on OS X.
+    // This is also the fallback when the temp file is on another volume
+    // and the way links to the book are kept intact.
+    QFile temp_epub(tempfilepath);
 
     if (!temp_epub.open(QFile::ReadOnly)) {
-        throw(CannotOpenFile(tempFile.toStdString()));
+        QFile::remove(tempfilepath);
+        throw(CannotOpenFile(tempfilepath.toStdString()));
     }
 
     QFile real_epub(fullfilepath);
 
     if (!real_epub.open(QFile::WriteOnly | QFile::Truncate)) {
         temp_epub.close();
+        QFile::remove(tempfilepath);
         throw(CannotWriteFile(fullfilepath.toStdString()));
     }
 
     // Copy the contents from the temp file to the real file.
-    char buff[BUFF_SIZE] = {0};
+    QByteArray buff(BUFF_SIZE, 0);
     qint64 read = 0;
     qint64 written = 0;
 
-    while ((read = temp_epub.read(buff, BUFF_SIZE)) > 0) {
-        written = real_epub.write(buff, read);
+    while ((read = temp_epub.read(buff.data(), BUFF_SIZE)) > 0) {
+        written = real_epub.write(buff.constData(), read);
 
         if (written != read) {
             temp_epub.close();
             real_epub.close();
-            QFile::remove(tempFile);
+            QFile::remove(tempfilepath);
             throw(CannotCopyFile(fullfilepath.toStdString()));
         }
     }
@@ -253,35 +655,30 @@ void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const
     if (read == -1) {
         temp_epub.close();
         real_epub.close();
-        QFile::remove(tempFile);
+        QFile::remove(tempfilepath);
         throw(CannotCopyFile(fullfilepath.toStdString()));
     }
 
     temp_epub.close();
     real_epub.close();
-    QFile::remove(tempFile);
+    QFile::remove(tempfilepath);
 }
 
 
-void ExportEPUB::CreateEncryptionXML(const QString &fullfolderpath)
+QByteArray ExportEPUB::CreateEncryptionXML()
 {
-    QTemporaryFile file;
-
-    if (!file.open()) {
-    std::string msg = file.fileName().toStdString() + ": " + file.errorString().toStdString();
-        throw (CannotOpenFile(msg));
-    }
-
-    EncryptionXmlWriter enc(m_Book.data(), file);
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    EncryptionXmlWriter enc(m_Book.data(), buffer);
     enc.WriteXML();
-    // Write to disk immediately
-    file.flush();
-    QFile::copy(file.fileName(), fullfolderpath + "/" + ENCRYPTION_XML_FILE_NAME);
+    buffer.close();
+    return buffer.data();
 }
 
 
-void ExportEPUB::ObfuscateFonts(const QString &fullfolderpath)
+QHash<QString, std::pair<QString, QString> > ExportEPUB::GetFontObfuscations()
 {
+    QHash<QString, std::pair<QString, QString> > obfuscations;
     QString uuid_id = m_Book->GetOPF()->GetUUIDIdentifierValue();
     QString main_id = m_Book->GetPublicationIdentifier();
     QList<FontResource *> font_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<FontResource>();
@@ -292,12 +689,11 @@ void ExportEPUB::ObfuscateFonts(const QString &fullfolderpath)
             continue;
         }
 
-        QString font_path = fullfolderpath + "/" + font_resource->GetRelativePath();
-
         if (algorithm == ADOBE_FONT_ALGO_ID) {
-            FontObfuscation::ObfuscateFile(font_path, algorithm, uuid_id);
+            obfuscations.insert(font_resource->GetRelativePath(), std::make_pair(algorithm, uuid_id));
         } else {
-            FontObfuscation::ObfuscateFile(font_path, algorithm, main_id);
+            obfuscations.insert(font_resource->GetRelativePath(), std::make_pair(algorithm, main_id));
         }
     }
+    return obfuscations;
 }
@@ -24,6 +24,10 @@
 #ifndef EXPORTEPUB_H
 #define EXPORTEPUB_H
 
+#include <utility>
+
+#include <QtCore/QHash>
+
 #include "BookManipulation/FolderKeeper.h"
 #include "BookManipulation/Book.h"
 #include "Exporters/Exporter.h"
@@ -47,22 +51,22 @@ public:
 
 private:
 
-    // Creates the publication from the Book
-    // (creates XHTML, CSS, OPF, NCX files etc.)
-    void virtual CreatePublication(const QString &fullfolderpath);
-
-    // Saves the publication in the specified folder
-    // to the specified file path as an epub;
-    // the second optional parameter specifies the
-    // mimetype to write to the special "mimetype" file
+    // Streams the book folder straight into a new epub
+    // archive at the specified file path, adding the generated
+    // encryption.xml and obfuscating fonts on the fly
     void SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath);
 
-    // Creates the publication's encryption.xml file,
-    // if there are any fonts to obfuscate
-    void CreateEncryptionXML(const QString &fullfolderpath);
+    // Replaces the destination with the finished archive,
+    // with an atomic rename where the platform allows
+    void CommitEpubToLocation(const QString &tempfilepath, const QString &fullfilepath);
+
+    // Returns the publication's encryption.xml,
+    // for when there are fonts to obfuscate
+    QByteArray CreateEncryptionXML();
 
-    // Obfuscates the fonts marked for obfuscation
-    void ObfuscateFonts(const QString &fullfolderpath);
+    // Returns the obfuscation algorithm and key for every
+    // font that needs obfuscating, keyed by its book path
+    QHash<QString, std::pair<QString, QString> > GetFontObfuscations();
 
 
     ///////////////////////////////
@@ -40,6 +40,7 @@
 #include <QtCore/QFutureSynchronizer>
 #include <QtConcurrent/QtConcurrent>
 #include <QtCore/QXmlStreamReader>
+#include <QtCore/QElapsedTimer>
 #include <QDirIterator>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
@@ -70,8 +71,8 @@
 // Set Max length to 256 because that's the max path size on many systems.
 #define MAX_PATH 256
 #endif
-// This is the same read buffer size used by Java and Perl.
-#define BUFF_SIZE 8192
+// Entries are inflated through a buffer this large
+#define BUFF_SIZE 262144
 
 const QString DUBLIN_CORE_NS             = "http://purl.org/dc/elements/1.1/";
 static const QString OEBPS_MIMETYPE      = "application/oebps-package+xml";
@@ -174,7 +175,7 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
                 }
             }
             if (ss.cleanOn() & CLEANON_OPEN) {
-                if (!XhtmlDoc::IsDataWellFormed(hresource->GetText(),hresource->GetEpubVersion())) {
+                if (!hresource->IsWellFormed()) {
                     non_well_formed << hresource;
                 } else {
 		    QString txt = hresource->GetText();
@@ -266,6 +267,9 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
     // InitialLoad on all TextResources to make sure everything gets loaded
     m_Book->GetFolderKeeper()->PerformInitialLoads();
 
+    // Remember the compressed entries so unchanged files can be copied on save
+    m_Book->GetZipEntryCache().Record(m_FullFilePath);
+
     // If we have modified the book to add spine attribute, manifest item or NCX mark as changed.
     m_Book->SetModified(GetLoadWarnings().count() > 0);
     QApplication::restoreOverrideCursor();
@@ -402,19 +406,111 @@ void ImportEPUB::ProcessFontFiles(const QList<Resource *> &resources,
     }
 }
 
-void ImportEPUB::ExtractContainer()
+// One archive entry to extract, found while reading the central directory
+struct ExtractEntry {
+    // minizip's unz64_file_pos for the entry
+    ZPOS64_T pos_in_zip_directory;
+    ZPOS64_T num_of_file;
+    qint64 size;
+    QString name;
+    QString file_path;
+    QString cp437_file_path;
+};
+
+
+static unzFile OpenArchive(const QString &zip_path)
 {
-    int res = 0;
-    if (!cp437) {
-        cp437 = new QCodePage437Codec();
-    }
 #ifdef Q_OS_WIN32
     zlib_filefunc64_def ffunc;
     fill_win32_filefunc64W(&ffunc);
-    unzFile zfile = unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(m_FullFilePath)).c_str(), &ffunc);
+    return unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(zip_path)).c_str(), &ffunc);
 #else
-    unzFile zfile = unzOpen64(QDir::toNativeSeparators(m_FullFilePath).toUtf8().constData());
+    return unzOpen64(QDir::toNativeSeparators(zip_path).toUtf8().constData());
 #endif
+}
+
+
+// Extracts a run of entries with its own archive handle so runs can
+// be processed on different threads. Returns the name of the entry that
+// could not be extracted or an empty string if they all were.
+static QString ExtractEntryRun(const QString &zip_path, const QList<ExtractEntry> &entries)
+{
+    if (entries.isEmpty()) {
+        return QString();
+    }
+
+    unzFile zfile = OpenArchive(zip_path);
+
+    if (zfile == NULL) {
+        return entries.first().name;
+    }
+
+    QByteArray buff(BUFF_SIZE, 0);
+
+    foreach(const ExtractEntry &extract_entry, entries) {
+        unz64_file_pos file_pos;
+        file_pos.pos_in_zip_directory = extract_entry.pos_in_zip_directory;
+        file_pos.num_of_file = extract_entry.num_of_file;
+
+        // Open the file entry in the archive for reading.
+        if ((unzGoToFilePos64(zfile, &file_pos) != UNZ_OK) || (unzOpenCurrentFile(zfile) != UNZ_OK)) {
+            unzClose(zfile);
+            return extract_entry.name;
+        }
+
+        // Open the file on disk to write the entry in the archive to.
+        QFile entry(extract_entry.file_path);
+
+        if (!entry.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            unzCloseCurrentFile(zfile);
+            unzClose(zfile);
+            return extract_entry.name;
+        }
+
+        // Buffered reading and writing.
+        int read = 0;
+        bool write_ok = true;
+
+        while ((read = unzReadCurrentFile(zfile, buff.data(), BUFF_SIZE)) > 0) {
+            if (entry.write(buff.constData(), read) != read) {
+                write_ok = false;
+                break;
+            }
+        }
+
+        entry.close();
+
+        // Read errors are marked by a negative read amount.
+        if ((read < 0) || !write_ok) {
+            unzCloseCurrentFile(zfile);
+            unzClose(zfile);
+            return extract_entry.name;
+        }
+
+        // The file was read but the CRC did not match.
+        // We don't check the read file size vs the uncompressed file size
+        // because if they're different there should be a CRC error.
+        if (unzCloseCurrentFile(zfile) == UNZ_CRCERROR) {
+            unzClose(zfile);
+            return extract_entry.name;
+        }
+    }
+
+    unzClose(zfile);
+    return QString();
+}
+
+
+void ImportEPUB::ExtractContainer()
+{
+    QElapsedTimer timer;
+    timer.start();
+    QList<ExtractEntry> extract_entries;
+    int res = 0;
+    if (!cp437) {
+        cp437 = new QCodePage437Codec();
+    }
+    unzFile zfile = OpenArchive(m_FullFilePath);
 
     if (zfile == NULL) {
         throw (EPUBLoadParseError(QString(QObject::tr("Cannot unzip EPUB: %1")).arg(QDir::toNativeSeparators(m_FullFilePath)).toStdString()));
@@ -497,49 +593,24 @@ void ImportEPUB::ExtractContainer()
 		    }
                 }
 
-                // Open the file entry in the archive for reading.
-                if (unzOpenCurrentFile(zfile) != UNZ_OK) {
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
-
-                // Open the file on disk to write the entry in the archive to.
-                QFile entry(file_path);
-
-                if (!entry.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-                    unzCloseCurrentFile(zfile);
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
-
-                // Buffered reading and writing.
-                char buff[BUFF_SIZE] = {0};
-                int read = 0;
-
-                while ((read = unzReadCurrentFile(zfile, buff, BUFF_SIZE)) > 0) {
-                    entry.write(buff, read);
-                }
-
-                entry.close();
-
-                // Read errors are marked by a negative read amount.
-                if (read < 0) {
-                    unzCloseCurrentFile(zfile);
+                // Remember where the entry is so it can be inflated later
+                // by one of the extraction threads.
+                unz64_file_pos file_pos;
+                if (unzGetFilePos64(zfile, &file_pos) != UNZ_OK) {
                     unzClose(zfile);
                     throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
                 }
 
-                // The file was read but the CRC did not match.
-                // We don't check the read file size vs the uncompressed file size
-                // because if they're different there should be a CRC error.
-                if (unzCloseCurrentFile(zfile) == UNZ_CRCERROR) {
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
+                ExtractEntry extract_entry;
+                extract_entry.pos_in_zip_directory = file_pos.pos_in_zip_directory;
+                extract_entry.num_of_file = file_pos.num_of_file;
+                extract_entry.size = file_info.uncompressed_size;
+                extract_entry.name = qfile_name;
+                extract_entry.file_path = file_path;
                 if (!cp437_file_name.isEmpty() && cp437_file_name != qfile_name) {
-                    QString cp437_file_path = m_ExtractedFolderPath + "/" + cp437_file_name;
-                    QFile::copy(file_path, cp437_file_path);
+                    extract_entry.cp437_file_path = m_ExtractedFolderPath + "/" + cp437_file_name;
                 }
+                extract_entries.append(extract_entry);
             }
         } while ((res = unzGoToNextFile(zfile)) == UNZ_OK);
     }
@@ -550,6 +621,70 @@ void ImportEPUB::ExtractContainer()
     }
 
     unzClose(zfile);
+    qint64 directory_ms = timer.restart();
+
+    // A file name used more than once ends up with the last entry's content,
+    // extract only that one so no two threads ever write the same file.
+    QHash<QString, int> last_entry;
+    for (int i = 0; i < extract_entries.count(); ++i) {
+        last_entry.insert(extract_entries.at(i).file_path, i);
+    }
+    if (last_entry.count() != extract_entries.count()) {
+        QList<ExtractEntry> unique_entries;
+        for (int i = 0; i < extract_entries.count(); ++i) {
+            if (last_entry.value(extract_entries.at(i).file_path) == i) {
+                unique_entries.append(extract_entries.at(i));
+            }
+        }
+        extract_entries = unique_entries;
+    }
+
+    // Inflate the entries in parallel. They are split into runs of roughly
+    // equal size, each extracted in order through its own archive handle.
+    QList<QList<ExtractEntry> > runs;
+    qint64 total_size = 0;
+    foreach(const ExtractEntry &extract_entry, extract_entries) {
+        total_size += extract_entry.size;
+    }
+    qint64 run_target = qMax<qint64>(total_size / (qMax(QThread::idealThreadCount(), 1) * 4), 1);
+    qint64 run_size = 0;
+    // Names differing only in case are the same file on case insensitive
+    // file systems, so they go into one run and are written in order.
+    QHash<QString, int> run_of_name;
+    foreach(const ExtractEntry &extract_entry, extract_entries) {
+        QString folded_path = extract_entry.file_path.toCaseFolded();
+        if (run_of_name.contains(folded_path)) {
+            runs[run_of_name.value(folded_path)].append(extract_entry);
+            continue;
+        }
+        if (runs.isEmpty() || (run_size >= run_target)) {
+            runs.append(QList<ExtractEntry>());
+            run_size = 0;
+        }
+        runs.last().append(extract_entry);
+        run_of_name.insert(folded_path, runs.count() - 1);
+        run_size += extract_entry.size;
+    }
+
+    QFuture<QString> future = QtConcurrent::mapped(runs, std::bind(ExtractEntryRun, m_FullFilePath, std::placeholders::_1));
+    future.waitForFinished();
+    for (int i = 0; i < future.results().count(); i++) {
+        QString failed_name = future.resultAt(i);
+        if (!failed_name.isEmpty()) {
+            throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(failed_name).toStdString()));
+        }
+    }
+
+    // The cp437 copies may land on paths another run writes to,
+    // so they are only made once every entry is on disk.
+    foreach(const ExtractEntry &extract_entry, extract_entries) {
+        if (!extract_entry.cp437_file_path.isEmpty()) {
+            QFile::copy(extract_entry.file_path, extract_entry.cp437_file_path);
+        }
+    }
+
+    qDebug() << "ExtractContainer:" << extract_entries.count() << "files," << total_size << "bytes,"
+             << "directory" << directory_ms << "ms, extraction" << timer.elapsed() << "ms on" << runs.count() << "runs";
 }
 
 void ImportEPUB::LocateOPF()
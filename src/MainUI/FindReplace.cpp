@@ -24,6 +24,7 @@
 #include <pcre.h>
 
 #include <QtGui/QKeyEvent>
+#include <QtGui/QTextDocument>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QMessageBox>
 #include <QtWidgets/QCompleter>
@@ -180,6 +181,7 @@ void FindReplace::ShowMessage(const QString &message)
     }
 
     ui.message->setText(new_message);
+    ui.message->setToolTip(QString());
     m_timer.start(SHOW_FIND_RESULTS_MESSAGE_DELAY_MS);
     emit ShowMessageRequest(new_message);
 }
@@ -482,6 +484,7 @@ void FindReplace::expireMessage()
 {
     m_timer.stop();
     ui.message->clear();
+    ui.message->setToolTip(QString());
     emit ShowMessageRequest("");
 }
 
@@ -1242,9 +1245,24 @@ void FindReplace::CountAllSearch(QList<SearchEditorModel::searchEntry *> search_
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
     int count = 0;
-    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
-        LoadSearch(search_entry);
-        count += Count();
+    QStringList names;
+    QList<int> counts;
+    if (CanRunSearchGroupInOnePass()) {
+        m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+        QStringList search_regexes;
+        foreach(SearchOperations::SearchReplace search, LoadSearchGroup(search_entries, names)) {
+            search_regexes.append(search.search_regex);
+        }
+        SetCodeViewIfNeeded(true);
+        counts = SearchOperations::CountAllInFiles(search_regexes, GetHTMLFiles(), SearchOperations::CodeViewSearch);
+        foreach(int search_count, counts) {
+            count += search_count;
+        }
+    } else {
+        foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+            LoadSearch(search_entry);
+            count += Count();
+        }
     }
     m_IsSearchGroupRunning = false;
 
@@ -1252,7 +1270,7 @@ void FindReplace::CountAllSearch(QList<SearchEditorModel::searchEntry *> search_
         CannotFindSearchTerm();
     } else if (count > 0) {
         QString message = tr("Matches found: %n", "", count);
-        ShowMessage(message);
+        ShowSearchGroupMessage(message, names, counts);
     }
 
     ResetKeyModifiers();
@@ -1268,9 +1286,27 @@ void FindReplace::ReplaceAllSearch(QList<SearchEditorModel::searchEntry *> searc
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
     int count = 0;
-    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
-        LoadSearch(search_entry);
-        count += ReplaceAll();
+    QStringList names;
+    QList<int> counts;
+    if (CanRunSearchGroupInOnePass()) {
+        // every file is read and set once for the whole group
+        m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+        QList<SearchOperations::SearchReplace> searches = LoadSearchGroup(search_entries, names);
+        SetCodeViewIfNeeded(true);
+        counts = SearchOperations::ReplaceAllInAllFiles(searches, GetHTMLFiles(), SearchOperations::CodeViewSearch);
+        foreach(int search_count, counts) {
+            count += search_count;
+        }
+        if (count > 0) {
+            // Signal that the contents have changed and update the view
+            m_MainWindow->GetCurrentBook()->SetModified(true);
+            m_MainWindow->GetCurrentContentTab()->ContentChangedExternally();
+        }
+    } else {
+        foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+            LoadSearch(search_entry);
+            count += ReplaceAll();
+        }
     }
     m_IsSearchGroupRunning = false;
 
@@ -1278,12 +1314,53 @@ void FindReplace::ReplaceAllSearch(QList<SearchEditorModel::searchEntry *> searc
         ShowMessage(tr("No replacements made"));
     } else {
         QString message = tr("Replacements made: %n", "", count);
-        ShowMessage(message);
+        ShowSearchGroupMessage(message, names, counts);
     }
 
     ResetKeyModifiers();
 }
 
+bool FindReplace::CanRunSearchGroupInOnePass()
+{
+    // Not wrapping splits the files around the current one and
+    // searches within the current file or marked text use the editor
+    return (GetLookWhere() == FindReplace::LookWhere_AllHTMLFiles ||
+            GetLookWhere() == FindReplace::LookWhere_SelectedHTMLFiles) &&
+           !m_LookWhereCurrentFile && !IsMarkedText() && m_OptionWrap;
+}
+
+QList<SearchOperations::SearchReplace> FindReplace::LoadSearchGroup(QList<SearchEditorModel::searchEntry *> search_entries,
+                                                                    QStringList &names)
+{
+    QList<SearchOperations::SearchReplace> searches;
+    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+        // LoadSearch deletes the entry
+        QString name = search_entry->name;
+        LoadSearch(search_entry);
+        if (!IsValidFindText()) {
+            continue;
+        }
+        SearchOperations::SearchReplace search;
+        search.search_regex = GetSearchRegex();
+        search.replacement = ui.cbReplace->lineEdit()->text();
+        searches.append(search);
+        names.append(name);
+    }
+    return searches;
+}
+
+void FindReplace::ShowSearchGroupMessage(const QString &message, const QStringList &names, const QList<int> &counts)
+{
+    ShowMessage(message);
+    QStringList details;
+    for (int i = 0; i < counts.count(); ++i) {
+        QString name = names.at(i).isEmpty() ? tr("Unnamed search") : names.at(i);
+        details.append(QString("%1: %2").arg(name).arg(counts.at(i)));
+    }
+    // names are user text, keep Qt from taking them for rich text
+    ui.message->setToolTip(Qt::convertFromPlainText(details.join("\n"), Qt::WhiteSpaceNormal));
+}
+
 
 void FindReplace::SetSearchMode(int search_mode)
 {
@@ -206,6 +206,24 @@ private:
 
     int ReplaceInAllFiles();
 
+    /**
+     * Checks if a saved search group can be run over the files in one
+     * pass, that is when each search would just go through all of them.
+     */
+    bool CanRunSearchGroupInOnePass();
+
+    /**
+     * Loads each search of a group in turn and collects the regex and
+     * replacement it runs with, skipping those with no find text.
+     *
+     * @param names Receives the name of each search collected.
+     */
+    QList<SearchOperations::SearchReplace> LoadSearchGroup(QList<SearchEditorModel::searchEntry *> search_entries,
+                                                           QStringList &names);
+
+    // Shows the message with the count of each search of a group as its tooltip
+    void ShowSearchGroupMessage(const QString &message, const QStringList &names, const QList<int> &counts);
+
     bool FindInAllFiles(Searchable::Direction direction);
 
     HTMLResource *GetNextContainingHTMLResource(Searchable::Direction direction);
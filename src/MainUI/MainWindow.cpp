@@ -4733,13 +4733,20 @@ bool MainWindow::SaveFile(const QString &fullfilepath, bool update_current_filen
 
         QList <HTMLResource *> broken_resources;
         bool not_well_formed = false;
+        QList <HTMLResource *> html_resources;
         Q_FOREACH(Resource * r, GetAllHTMLResources()) {
             HTMLResource *t = qobject_cast<HTMLResource *>(r);
             if (t) {
-                if (!XhtmlDoc::IsDataWellFormed(t->GetText())) {
-                    not_well_formed = true;
-                    broken_resources.append(t);
-                }
+                html_resources.append(t);
+            }
+        }
+        // verdicts are cached per text revision so only edited files are rechecked
+        QList< std::pair<HTMLResource *, bool> > verdicts =
+            QtConcurrent::blockingMapped(html_resources, Book::ResourceWellFormedMap);
+        for (int i = 0; i < verdicts.count(); i++) {
+            if (!verdicts.at(i).second) {
+                not_well_formed = true;
+                broken_resources.append(verdicts.at(i).first);
             }
         }
         if (ss.cleanOn() & CLEANON_SAVE) {
@@ -404,7 +404,8 @@ bool OPFModel:: RenameResourceList(const QList<Resource *> &resources, const QSt
     }
 
     if (update.count() > 0) {
-        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update);
+        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update,
+                                                  QList<XMLResource *>(), m_Book->GetFolderKeeper()->GetReferenceIndex());
         emit BookContentModified();
     }
 
@@ -465,7 +466,8 @@ bool OPFModel::MoveResourceList(const QList<Resource *> &resources, const QStrin
     }
 
     if (update.count() > 0) {
-        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update);
+        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update,
+                                                  QList<XMLResource *>(), m_Book->GetFolderKeeper()->GetReferenceIndex());
         emit BookContentModified();
     }
 
@@ -20,9 +20,9 @@
 **
 *************************************************************************/
 
-#include "Misc/EmbeddedPython.h"
-
 #include <QtCore/QFileInfo>
+#include <QtCore/QReadLocker>
+#include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QHeaderView>
 #include <QtWidgets/QTableWidget>
@@ -32,6 +32,7 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/FolderKeeper.h"
 #include "MainUI/ValidationResultsView.h"
+#include "ResourceObjects/HTMLResource.h"
 #include "Misc/Utility.h"
 #include "sigil_exception.h"
 
@@ -41,8 +42,6 @@ static const QBrush WARNING_BRUSH = QBrush(QColor(255, 255, 230));
 static const QBrush ERROR_BRUSH   = QBrush(QColor(255, 230, 230));
 #endif
 
-const QString ValidationResultsView::SEP = QString(QChar(31));
-
 ValidationResultsView::ValidationResultsView(QWidget *parent)
     :
     QDockWidget(tr("Validation Results"), parent),
@@ -62,29 +61,10 @@ void ValidationResultsView::showEvent(QShowEvent *event)
 }
 
 
-QStringList ValidationResultsView::ValidateFile(QString &apath)
+// safe to run from any thread
+static QList<SanityCheck::Error> SanityCheckText(const QString &text)
 {
-    int rv = 0;
-    QString error_traceback;
-    QStringList results;
-
-    QList<QVariant> args;
-    args.append(QVariant(apath));
-
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("sanitycheck"),
-                                         QString("perform_sanity_check"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in sanitycheck perform_sanity_check: ") + QString::number(rv), 
-                                         error_traceback);
-        // an error happened - make no changes
-        return results;
-    }
-    return res.toStringList();
+    return SanityCheck(text).check();
 }
 
 
@@ -93,35 +73,50 @@ void ValidationResultsView::ValidateCurrentBook()
     ClearResults();
     QList<ValidationResult> results;
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    m_Book->SaveAllResourcesToDisk();
 
+    // Only files whose text changed since the last run need checking again.
+    // The texts are read here on the GUI thread and checked in parallel.
+    QList<HTMLResource *> html_resources;
+    QList<int> revisions;
+    QStringList pending_texts;
+    QList<int> pending_index;
+    QHash<QString, CachedSanityCheck> checks;
     QList<Resource *> resources = m_Book->GetFolderKeeper()->GetResourceList();
     foreach (Resource * resource, resources) {
-        if (resource->Type() == Resource::HTMLResourceType) {
-            QString apath = resource->GetFullPath();
-	    QString bookpath = resource->GetRelativePath();
-            QStringList reslst = ValidateFile(apath);
-            if (!reslst.isEmpty()) {
-                foreach (QString res, reslst) {
-                    QStringList details = res.split(SEP);
-                    ValidationResult::ResType vtype;
-                    QString etype = details[0];
-                    if (etype == "info") {
-                        vtype = ValidationResult::ResType_Info;
-                    } else if (etype == "warning") {
-                        vtype = ValidationResult::ResType_Warn;
-                    } else if (etype == "error") {
-                        vtype = ValidationResult::ResType_Error;
-                    } else {
-                        continue;
-                    }
-                    QString filename = details[1];
-                    int lineno = details[2].toInt();
-                    int charoffset = details[3].toInt();
-                    QString msg = details[4];
-                    results.append(ValidationResult(vtype,bookpath,lineno,charoffset,msg));
-                }
-            }
+        if (resource->Type() != Resource::HTMLResourceType) {
+            continue;
+        }
+        HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+        QReadLocker locker(&html_resource->GetLock());
+        // revision first so a concurrent edit can only make the entry stale
+        int revision = html_resource->GetTextRevision();
+        QString identifier = html_resource->GetIdentifier();
+        if (m_SanityCache.contains(identifier) && (m_SanityCache.value(identifier).revision == revision)) {
+            checks.insert(identifier, m_SanityCache.value(identifier));
+        } else {
+            pending_index.append(html_resources.count());
+            pending_texts.append(html_resource->GetText());
+        }
+        html_resources.append(html_resource);
+        revisions.append(revision);
+    }
+
+    const QList<QList<SanityCheck::Error>> fresh = QtConcurrent::blockingMapped(pending_texts, SanityCheckText);
+    for (int i = 0; i < pending_index.count(); ++i) {
+        int j = pending_index.at(i);
+        CachedSanityCheck check;
+        check.revision = revisions.at(j);
+        check.errors = fresh.at(i);
+        checks.insert(html_resources.at(j)->GetIdentifier(), check);
+    }
+    // dropping entries of files that are gone keeps the cache the size of the book
+    m_SanityCache = checks;
+
+    foreach (HTMLResource * html_resource, html_resources) {
+        QString bookpath = html_resource->GetRelativePath();
+        foreach (const SanityCheck::Error &error, m_SanityCache.value(html_resource->GetIdentifier()).errors) {
+            QString msg = error.message + ".  near column " + QString::number(error.col);
+            results.append(ValidationResult(ValidationResult::ResType_Error, bookpath, error.line, -1, msg));
         }
     }
     QApplication::restoreOverrideCursor();
@@ -150,6 +145,7 @@ void ValidationResultsView::ClearResults()
 void ValidationResultsView::SetBook(QSharedPointer<Book> book)
 {
     m_Book = book;
+    m_SanityCache.clear();
     ClearResults();
 }
 
@@ -26,10 +26,12 @@
 
 #include <vector>
 
+#include <QtCore/QHash>
 #include <QtCore/QSharedPointer>
 #include <QtWidgets/QDockWidget>
 
 #include "MainUI/MainWindow.h"
+#include "Misc/SanityCheck.h"
 #include "Misc/ValidationResult.h"
 
 class QTableWidget;
@@ -54,12 +56,11 @@ public:
     ValidationResultsView(QWidget *parent = 0);
 
     /**
-     * Validates the epub file given and displays the results.
+     * Checks every html file of the book and displays the results.
+     * Files unchanged since the previous run reuse their earlier result.
      */
     void ValidateCurrentBook();
 
-    QStringList ValidateFile(QString &apath);
-
     void LoadResults(const QList<ValidationResult> &results);
 
     /**
@@ -151,7 +152,15 @@ private:
      */
     QSharedPointer<Book> m_Book;
 
-    static const QString SEP;
+    struct CachedSanityCheck {
+        int revision;
+        QList<SanityCheck::Error> errors;
+    };
+
+    /**
+     * Results of the last run keyed by resource identifier.
+     */
+    QHash<QString, CachedSanityCheck> m_SanityCache;
 };
 
 #endif // VALIDATIONRESULTSVIEW_H
@@ -55,6 +55,7 @@ CSSInfo::CSSInfo(const QString &text, bool isCSSFile)
             offset = style_end;
         }
     }
+    buildSelectorIndexes();
 }
 
 // Need to manually clean up the Selector List
@@ -66,8 +67,11 @@ CSSInfo::~CSSInfo()
 }
 
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterClassName)
+QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterClassName) const
 {
+    if (!filterClassName.isEmpty()) {
+        return m_ClassIndex.value(filterClassName);
+    }
     QList<CSSInfo::CSSSelector *> selectors;
     foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
         if (cssSelector->classNames.count() > 0) {
@@ -79,7 +83,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterCla
     return selectors;
 }
 
-CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className)
+CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className) const
 {
     if (!className.isEmpty()) {
         // Find the selector(s) if any with this class name
@@ -104,16 +108,15 @@ CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elem
     } else {
 
         // try match on element name alone
-        foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
-            if (cssSelector->elementNames.contains(elementName) && cssSelector->classNames.isEmpty()) {
-                return cssSelector;
-            }
+        const QList<CSSInfo::CSSSelector *> element_selectors = m_ElementOnlyIndex.value(elementName);
+        if (!element_selectors.isEmpty()) {
+            return element_selectors.first();
         }
     }
     return NULL;
 }
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className)
+QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const
 {
     QList<CSSInfo::CSSSelector *> matches;
     if (!className.isEmpty()) {
@@ -138,11 +141,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const Q
         }
     } else {
         // try match on element name alone
-        foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
-            if (cssSelector->elementNames.contains(elementName) && cssSelector->classNames.isEmpty()) {
-                matches.append(cssSelector);
-            }
-        }
+        matches = m_ElementOnlyIndex.value(elementName);
     }
     return matches;
 }
@@ -560,6 +559,25 @@ void CSSInfo::parseCSSSelectors(const QString &text, const int &offsetLines, con
     }
 }
 
+void CSSInfo::buildSelectorIndexes()
+{
+    foreach(CSSSelector * cssSelector, m_CSSSelectors) {
+        if (cssSelector->classNames.isEmpty()) {
+            QStringList element_names = cssSelector->elementNames;
+            element_names.removeDuplicates();
+            foreach(QString element_name, element_names) {
+                m_ElementOnlyIndex[element_name].append(cssSelector);
+            }
+        } else {
+            QStringList class_names = cssSelector->classNames;
+            class_names.removeDuplicates();
+            foreach(QString class_name, class_names) {
+                m_ClassIndex[class_name].append(cssSelector);
+            }
+        }
+    }
+}
+
 QString CSSInfo::replaceBlockComments(const QString &text)
 {
     // We take a copy of the text and remove all block comments from it.
@@ -26,6 +26,7 @@
 #ifndef CSSINFO_H
 #define CSSINFO_H
 
+#include <QtCore/QHash>
 #include <QtCore/QObject>
 #include <QtCore/QStringList>
 
@@ -68,14 +69,14 @@ public:
     /**
      * Return selectors subset for only class based CSS declarations.
      */
-    QList<CSSSelector *> getClassSelectors(const QString filterClassName = "");
+    QList<CSSSelector *> getClassSelectors(const QString filterClassName = "") const;
 
     /**
      * Search for a line position for a tag element name and an optional
      * class name for the style.
      * Looks in order of: elementName.style, .style
      */
-    CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className);
+    CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Search for *all* CSS selector that match an elementName, and classname
@@ -83,7 +84,7 @@ public:
      * relate to more than one style
      */
 
-    QList<CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className);
+    QList<CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Return a list of all property values for the given property in the CSS.
@@ -111,8 +112,18 @@ private:
     bool findInlineStyleBlock(const QString &text, const int &offset, int &styleStart, int &styleEnd);
     void parseCSSSelectors(const QString &text, const int &offsetLines, const int &offsetPos);
     QString replaceBlockComments(const QString &text);
+    void buildSelectorIndexes();
 
     QList<CSSSelector *> m_CSSSelectors;
+
+    /**
+     * Lookup tables built once after parsing so the class and element
+     * queries do not scan every selector. The lists keep document order.
+     * Since they are never changed afterwards a CSSInfo can be shared
+     * read-only between threads.
+     */
+    QHash<QString, QList<CSSSelector *> > m_ClassIndex;
+    QHash<QString, QList<CSSSelector *> > m_ElementOnlyIndex;
     QString m_OriginalText;
     bool m_IsCSSFile;
 };
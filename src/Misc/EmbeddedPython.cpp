@@ -29,6 +29,7 @@
 #include <QMetaType>
 #include <QStandardPaths>
 #include <QDir>
+#include "Misc/PythonWorkerPool.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 
@@ -163,6 +164,7 @@
 
 
 QMutex EmbeddedPython::m_mutex;
+bool EmbeddedPython::m_headless = false;
 
 EmbeddedPython* EmbeddedPython::m_instance = 0;
 int EmbeddedPython::m_pyobjmetaid = 0;
@@ -381,6 +383,21 @@ cleanup:
 }
 
 
+// run the function in this thread's pooled helper process when possible
+QVariant EmbeddedPython::runInPythonWorker(const QString &mname,
+                                           const QString &fname,
+                                           const QVariantList &args,
+                                           int *rv,
+                                           QString &tb)
+{
+    QVariant res;
+    if (PythonWorkerPool::instance()->run(mname, fname, args, res, rv, tb)) {
+        return res;
+    }
+    return runInPython(mname, fname, args, rv, tb);
+}
+
+
 // given an existing python object instance, invoke one of its methods 
 // grabs mutex to prevent need for Python GIL
 QVariant EmbeddedPython::callPyObjMethod(PyObjectPtr &pyobj, 
@@ -632,7 +649,7 @@ QString EmbeddedPython::getPythonErrorTraceback(const QString& default_message,
     PyErr_Clear();
 
     QString tb = tblist.join(QString("\n"));
-    if (useMsgBox) {
+    if (useMsgBox && !m_headless) {
         QString message = QString(tr("Embedded Python Error"));
         Utility::DisplayStdErrorDialog(message, tb);
     }
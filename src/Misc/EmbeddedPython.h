@@ -54,6 +54,21 @@ public:
                          QString &error_traceback,
                          bool ret_python_object = false);
 
+    /**
+     * Same as runInPython for plain data in and out but, when called
+     * from a worker thread, runs the call in a pooled helper process
+     * so that independent jobs are not serialized on one interpreter.
+     * Falls back to running in-process whenever no helper is available.
+     */
+    QVariant runInPythonWorker(const QString &module_name,
+                               const QString &function_name,
+                               const QVariantList &args,
+                               int *pRV,
+                               QString &error_traceback);
+
+    // suppress error message boxes (used by the headless helper processes)
+    static void setHeadless(bool headless) { m_headless = headless; }
+
     QVariant callPyObjMethod(PyObjectPtr &pyobj, 
                              const QString &methname, 
                              const QVariantList &args, 
@@ -73,6 +88,7 @@ private:
 				    bool useMsgBox = true);
 
     static QMutex m_mutex;
+    static bool m_headless;
     static EmbeddedPython *m_instance;
     static int m_pyobjmetaid;
     static PyThreadState *m_threadstate;
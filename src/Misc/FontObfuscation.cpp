@@ -55,55 +55,42 @@ QByteArray AdobeKeyFromIdentifier(const QString &identifier)
 }
 
 
-void IdpfObfuscate(const QString &filepath, const QString &identifier)
+void XorPrefix(QByteArray &contents, const QByteArray &key, int num_bytes)
 {
-    QFile file(filepath);
-
-    if (!file.open(QFile::ReadWrite)) {
-        return;
-    }
-
-    QByteArray contents = file.readAll();
-    QByteArray key = IdpfKeyFromIdentifier(identifier);
-    int key_size   = key.size();
+    int key_size = key.size();
     if (key_size == 0) {
         return;
     }
 
-    for (int i = 0; (i < IDPF_METHOD_NUM_BYTES) && (i < contents.size()); ++i) {
+    for (int i = 0; (i < num_bytes) && (i < contents.size()); ++i) {
         contents[ i ] = contents[ i ] ^ key[ i % key_size ];
     }
-
-    file.seek(0);
-    file.write(contents);
 }
 
+};
 
-void AdobeObfuscate(const QString &filepath, const QString &identifier)
-{
-    QFile file(filepath);
-
-    if (!file.open(QFile::ReadWrite)) {
-        return;
-    }
 
-    QByteArray contents = file.readAll();
-    QByteArray key = AdobeKeyFromIdentifier(identifier);
-    int key_size   = key.size();
-    if (key_size == 0) {
-        return;
+QByteArray FontObfuscation::ObfuscateData(const QByteArray &data,
+                                          const QString &algorithm,
+                                          const QString &identifier)
+{
+    if (algorithm.isEmpty() || identifier.isEmpty()) {
+        std::string msg = algorithm.toStdString() + ": " + identifier.toStdString();
+        throw(FontObfuscationError(msg));
     }
 
-    for (int i = 0; (i < ADOBE_METHOD_NUM_BYTES) && (i < contents.size()); ++i) {
-        contents[ i ] = contents[ i ] ^ key[ i % key_size ];
+    QByteArray contents = data;
+    if (algorithm == ADOBE_FONT_ALGO_ID) {
+        XorPrefix(contents, AdobeKeyFromIdentifier(identifier), ADOBE_METHOD_NUM_BYTES);
+    } else if (algorithm == IDPF_FONT_ALGO_ID) {
+        XorPrefix(contents, IdpfKeyFromIdentifier(identifier), IDPF_METHOD_NUM_BYTES);
+    } else {
+        std::string msg = algorithm.toStdString() + ": " + identifier.toStdString();
+        throw(FontObfuscationError(msg));
     }
-
-    file.seek(0);
-    file.write(contents);
+    return contents;
 }
 
-};
-
 
 void FontObfuscation::ObfuscateFile(const QString &filepath,
                                     const QString &algorithm,
@@ -116,14 +103,18 @@ void FontObfuscation::ObfuscateFile(const QString &filepath,
         throw(FontObfuscationError(msg));
     }
 
-    if (algorithm == ADOBE_FONT_ALGO_ID) {
-        AdobeObfuscate(filepath, identifier);
-    } else if (algorithm == IDPF_FONT_ALGO_ID) {
-        IdpfObfuscate(filepath, identifier);
-    } else {
+    if ((algorithm != ADOBE_FONT_ALGO_ID) && (algorithm != IDPF_FONT_ALGO_ID)) {
         std::string msg = filepath.toStdString() + ": " + algorithm.toStdString() + ": " + identifier.toStdString();
         throw(FontObfuscationError(msg));
     }
-}
 
+    QFile file(filepath);
+
+    if (!file.open(QFile::ReadWrite)) {
+        return;
+    }
 
+    QByteArray contents = ObfuscateData(file.readAll(), algorithm, identifier);
+    file.seek(0);
+    file.write(contents);
+}
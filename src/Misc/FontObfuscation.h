@@ -23,10 +23,17 @@
 #ifndef FONTOBFUSCATION_H
 #define FONTOBFUSCATION_H
 
+class QByteArray;
 class QString;
 
 namespace FontObfuscation
 {
+// Returns a copy of the font data with the given algorithm applied.
+// The obfuscation is its own inverse so this also deobfuscates.
+QByteArray ObfuscateData(const QByteArray &data,
+                         const QString &algorithm,
+                         const QString &identifier);
+
 void ObfuscateFile(const QString &filepath,
                    const QString &algorithm,
                    const QString &identifier);
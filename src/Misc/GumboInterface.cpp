@@ -28,6 +28,9 @@
 #include <QFileInfo>
 // #include <QDebug>
 
+#include <string.h>
+#include <vector>
+
 #include "Misc/Utility.h"
 #include "Misc/GumboInterface.h"
 #include "string_buffer.h"
@@ -101,13 +104,97 @@ QHash<QString,QString> EmptyHash = QHash<QString,QString>();
 
 // These need to match the GumboAttributeNamespaceEnum sequence
 static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" };
+
+// Returns the offset just past the xml header (searching for its end from
+// "from") and any whitespace after it, the source itself is never modified
+static int xml_header_end(const QByteArray &src, int from)
+{
+    int end = src.indexOf('>', from) + 1;
+    if (end == 0) {
+        return 0;
+    }
+    while (end < src.size()) {
+        char c = src.at(end);
+        if ((c != ' ') && (c != '\n') && (c != '\r') && (c != '\t') && (c != '\v') && (c != '\f')) {
+            break;
+        }
+        end++;
+    }
+    return end;
+}
+
+
+// Extra room reserved beyond the source size when serializing
+static const size_t SERIALIZE_SLACK = 4096;
+
+// Tag categories used while serializing, as bits so one lookup answers all
+enum TagCategory {
+    TAG_NONBREAKING_INLINE  = 1 << 0,
+    TAG_PRESERVE_WHITESPACE = 1 << 1,
+    TAG_SPECIAL_HANDLING    = 1 << 2,
+    TAG_NO_ENTITY_SUB       = 1 << 3,
+    TAG_VOID                = 1 << 4,
+    TAG_STRUCTURAL          = 1 << 5,
+    TAG_HREF_SRC            = 1 << 6
+};
+
+
+static unsigned int categories_for_tagname(const std::string &tagname)
+{
+    unsigned int categories = 0;
+    if (nonbreaking_inline.count(tagname))  categories |= TAG_NONBREAKING_INLINE;
+    if (preserve_whitespace.count(tagname)) categories |= TAG_PRESERVE_WHITESPACE;
+    if (special_handling.count(tagname))    categories |= TAG_SPECIAL_HANDLING;
+    if (no_entity_sub.count(tagname))       categories |= TAG_NO_ENTITY_SUB;
+    if (void_tags.count(tagname))           categories |= TAG_VOID;
+    if (structural_tags.count(tagname))     categories |= TAG_STRUCTURAL;
+    if (href_src_tags.count(tagname))       categories |= TAG_HREF_SRC;
+    return categories;
+}
+
+
+// The categories of every known GumboTag, built once from the sets above
+// so the enum lookup always agrees with looking up the tag name
+static std::vector<unsigned int> build_tag_category_table()
+{
+    std::vector<unsigned int> table(GUMBO_TAG_LAST + 1, 0);
+    for (int tag = 0; tag < GUMBO_TAG_UNKNOWN; tag++) {
+        table[tag] = categories_for_tagname(gumbo_normalized_tagname(static_cast<GumboTag>(tag)));
+    }
+    return table;
+}
+
+
+// Appends text with the same entities substituted as substitute_xml_entities_into_text
+// but without building a temporary string for every text node
+static void append_with_xml_entities(std::string &out, const char *text, size_t len)
+{
+    const char *end = text + len;
+    const char *run = text;
+    for (const char *p = text; p != end; ++p) {
+        const char *entity;
+        switch (*p) {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            default: entity = NULL; break;
+        }
+        if (entity) {
+            out.append(run, p - run);
+            out.append(entity);
+            run = p + 1;
+        }
+    }
+    out.append(run, end - run);
+}
  
 // Note: m_output contains the gumbo output tree which 
 // has data structures with pointers into the original source
 // buffer passed in!!!!!!
 
-// This source buffer is provided by the m_utf8src std::string
-// which should always exist unchanged alongside the output tree
+// This source buffer is provided by the m_utf8src QByteArray
+// (from m_utf8start on) which should always exist unchanged
+// alongside the output tree
 
 // Do NOT change or delete m_utf8src once set until after you 
 // have properly destroyed the gumbo output tree
@@ -115,7 +202,9 @@ static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" }
 GumboInterface::GumboInterface(const QString &source, const QString &version)
         : m_source(source),
           m_output(NULL),
-          m_utf8src(""),
+          m_arena(NULL),
+          m_utf8src(),
+          m_utf8start(0),
           m_sourceupdates(EmptyHash),
           m_newcsslinks(""),
           m_currentbkpath(""),
@@ -130,7 +219,9 @@ GumboInterface::GumboInterface(const QString &source, const QString &version)
 GumboInterface::GumboInterface(const QString &source, const QString &version, const QHash<QString,QString> & source_updates)
         : m_source(source),
           m_output(NULL),
-          m_utf8src(""),
+          m_arena(NULL),
+          m_utf8src(),
+          m_utf8start(0),
           m_sourceupdates(source_updates),
           m_newcsslinks(""),
           m_currentbkpath(""),
@@ -142,26 +233,72 @@ GumboInterface::GumboInterface(const QString &source, const QString &version, co
 }
 
 
+GumboInterface::GumboInterface(const QByteArray &utf8source, const QString &version)
+        : m_source(),
+          m_output(NULL),
+          m_arena(NULL),
+          m_utf8src(utf8source),
+          m_utf8start(0),
+          m_sourceupdates(EmptyHash),
+          m_newcsslinks(""),
+          m_currentbkpath(""),
+          m_currentdir(""),
+          m_newbody(""),
+          m_version(version),
+          m_newbookpath("")
+{
+}
+
+
 GumboInterface::~GumboInterface()
 {
     if (m_output != NULL) {
         gumbo_destroy_output(m_output);
         m_output = NULL;
-        m_utf8src = "";
+        m_utf8src = QByteArray();
+    }
+    // the tree (and any earlier parse of this source) lives in the arena
+    if (m_arena != NULL) {
+        gumbo_arena_destroy(m_arena);
+        m_arena = NULL;
+    }
+}
+
+
+bool GumboInterface::has_source() const
+{
+    return !m_source.isEmpty() || !m_utf8src.isEmpty();
+}
+
+
+// encode the source once, unless we were handed the UTF-8 to begin with
+void GumboInterface::load_utf8src()
+{
+    if (m_utf8src.isEmpty()) {
+        m_utf8src = m_source.toUtf8();
+    }
+}
+
+
+// each parse gets its own arena so parses running on different
+// threads never contend for the allocator and teardown is one release
+GumboArena* GumboInterface::get_parse_arena()
+{
+    if (m_arena == NULL) {
+        m_arena = gumbo_arena_create();
     }
+    return m_arena;
 }
 
 
 void GumboInterface::parse()
 {
-    if (!m_source.isEmpty() && (m_output == NULL)) {
+    if (has_source() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and any trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 5);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
+        load_utf8src();
+        // skip over any xml header line and any trailing whitespace
+        if (m_utf8src.startsWith("<?xml")) {
+            m_utf8start = xml_header_end(m_utf8src, 5);
         }
 
         // In case we ever have to revert to earlier versions, please note the following
@@ -176,9 +313,11 @@ void GumboInterface::parse()
         myoptions.stop_on_first_error = false;
         myoptions.max_tree_depth = 400;
         myoptions.max_errors = 50;
+        myoptions.arena = get_parse_arena();
 
         // GumboInterface::m_mutex.lock();
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.constData() + m_utf8start,
+                                            m_utf8src.size() - m_utf8start);
         // GumboInterface::m_mutex.unlock();
     }
 }
@@ -186,7 +325,7 @@ void GumboInterface::parse()
 
 void GumboInterface::parse_fragment()
 {
-    if (!m_source.isEmpty() && (m_output == NULL)) {
+    if (has_source() && (m_output == NULL)) {
 
         // In case we ever have to revert to earlier versions, please note the following
         // additional initialization is needed because Microsoft Visual Studio 2013 (and earlier?)
@@ -200,12 +339,13 @@ void GumboInterface::parse_fragment()
         myoptions.stop_on_first_error = false;
         myoptions.max_tree_depth = 400;
         myoptions.max_errors = 50;
+        myoptions.arena = get_parse_arena();
 
-        m_utf8src = m_source.toStdString();
-        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
+        load_utf8src();
+        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.constData(), m_utf8src.size(),
                                         GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
 
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.constData(), m_utf8src.size());
     }
 }
 
@@ -213,7 +353,7 @@ void GumboInterface::parse_fragment()
 QString GumboInterface::repair()
 {
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -228,7 +368,7 @@ QString GumboInterface::repair()
 QString GumboInterface::get_fragment_xhtml()
 {
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse_fragment();
         }
@@ -243,7 +383,7 @@ QString GumboInterface::get_fragment_xhtml()
 QString GumboInterface::getxhtml()
 {
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -258,7 +398,7 @@ QString GumboInterface::getxhtml()
 QString GumboInterface::prettyprint(QString indent_chars)
 {
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -274,7 +414,7 @@ QString GumboInterface::prettyprint(QString indent_chars)
 QStringList GumboInterface::get_all_properties()
 {
     QStringList properties;
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -291,7 +431,7 @@ QString GumboInterface::perform_source_updates(const QString& my_current_book_re
     m_currentdir = QFileInfo(m_currentbkpath).dir().path();
     m_newbookpath = newbookpath;
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -312,7 +452,7 @@ QString GumboInterface::perform_style_updates(const QString& my_current_book_rel
     m_newbookpath = newbookpath;
     
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -329,7 +469,7 @@ QString GumboInterface::perform_link_updates(const QString& newcsslinks)
 {
     m_newcsslinks = newcsslinks.toStdString();
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -344,7 +484,7 @@ QString GumboInterface::perform_link_updates(const QString& newcsslinks)
 
 GumboNode * GumboInterface::get_document_node()
 {
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -354,7 +494,7 @@ GumboNode * GumboInterface::get_document_node()
 
 
 GumboNode * GumboInterface::get_root_node() {
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -365,7 +505,7 @@ GumboNode * GumboInterface::get_root_node() {
 
 GumboNode * GumboInterface::get_body_node()
 {
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -381,7 +521,7 @@ GumboNode * GumboInterface::get_body_node()
 
 QString GumboInterface::get_body_contents() 
 {
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -398,7 +538,7 @@ QString GumboInterface::get_body_contents()
 
 QString GumboInterface::get_body_text() 
 {
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -548,7 +688,7 @@ GumboNode* GumboInterface::get_node_from_path(QList<unsigned int> & apath)
 QString GumboInterface::perform_body_updates(const QString & new_body) 
 {
     QString result = "";
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -584,29 +724,33 @@ QList<GumboWellFormedError> GumboInterface::error_check()
     myoptions.stop_on_first_error = false;
     myoptions.max_tree_depth = 400;
     myoptions.max_errors = -1;
+    myoptions.arena = get_parse_arena();
 
-    if (!m_source.isEmpty() && (m_output == NULL)) {
+    if (has_source() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 0);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
+        load_utf8src();
+        // skip over any xml header line and trailing whitespace
+        if (m_utf8src.startsWith("<?xml")) {
+            m_utf8start = xml_header_end(m_utf8src, 0);
             line_offset++;
         }
         // add in epub version specific doctype if missing
-        if ((m_utf8src.compare(0,9,"<!DOCTYPE") != 0) && (m_utf8src.compare(0,9,"<!doctype") != 0)) {
+        const char * start = m_utf8src.constData() + m_utf8start;
+        if ((qstrncmp(start, "<!DOCTYPE", 9) != 0) && (qstrncmp(start, "<!doctype", 9) != 0)) {
+            QByteArray doctype;
             if (m_version.startsWith('3')) {
-                m_utf8src.insert(0,"<!DOCTYPE html>\n");
+                doctype = "<!DOCTYPE html>\n";
             } else {
-                m_utf8src.insert(0, "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n");
+                doctype = "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n";
             }
+            m_utf8src = doctype + m_utf8src.mid(m_utf8start);
+            m_utf8start = 0;
             line_offset--;
         }
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.constData() + m_utf8start,
+                                            m_utf8src.size() - m_utf8start);
     }
-    // qDebug() << QString::fromStdString(m_utf8src);
+    // qDebug() << QString::fromUtf8(m_utf8src.mid(m_utf8start));
     const GumboVector* errors  = &m_output->errors;
     for (unsigned int i=0; i< errors->length; ++i) {
         GumboError* er = static_cast<GumboError*>(errors->data[i]);
@@ -643,11 +787,12 @@ QList<GumboWellFormedError> GumboInterface::fragment_error_check()
     myoptions.stop_on_first_error = false;
     myoptions.max_tree_depth = 400;
     myoptions.max_errors = -1;
+    myoptions.arena = get_parse_arena();
 
-    if (!m_source.isEmpty() && (m_output == NULL)) {
+    if (has_source() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
+        load_utf8src();
+        m_output = gumbo_parse_fragment(&myoptions, m_utf8src.constData(), m_utf8src.size(),
                                         GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
     }
     const GumboVector* errors  = &m_output->errors;
@@ -708,7 +853,7 @@ QList<GumboNode*> GumboInterface::get_element_nodes_with_prefix(GumboNode * node
 QList<GumboNode*> GumboInterface::get_all_nodes_with_attribute(const QString& attname)
 {
     QList<GumboNode*> nodes;
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
@@ -739,31 +884,66 @@ QList<GumboNode*> GumboInterface::get_nodes_with_attribute(GumboNode* node, cons
 QStringList GumboInterface::get_all_values_for_attribute(const QString& attname)
 {
     QStringList attrvals;
-    if (!m_source.isEmpty()) {
+    if (has_source()) {
         if (m_output == NULL) {
             parse();
         }
-        attrvals = get_values_for_attr(m_output->root, attname.toUtf8().constData()); 
+        get_values_for_attr(m_output->root, attname.toUtf8().constData(), attrvals);
     }
     return attrvals;
 }
 
 
-QStringList  GumboInterface::get_values_for_attr(GumboNode* node, const char* attr_name) 
+// collects into a single list rather than merging one list per node
+void GumboInterface::get_values_for_attr(GumboNode* node, const char* attr_name, QStringList &attr_vals)
 {
     if (node->type != GUMBO_NODE_ELEMENT) {
-        return QStringList();
+        return;
     }
-    QStringList attr_vals;
     GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, attr_name);
     if (attr != NULL) {
         attr_vals.append(QString::fromUtf8(attr->value));
     }
     GumboVector* children = &node->v.element.children;
     for (unsigned int i = 0; i < children->length; ++i) {
-        attr_vals.append(get_values_for_attr(static_cast<GumboNode*>(children->data[i]), attr_name));
+        get_values_for_attr(static_cast<GumboNode*>(children->data[i]), attr_name, attr_vals);
+    }
+}
+
+
+void GumboInterface::get_all_reference_values(QStringList &urls, QStringList &styles)
+{
+    if (has_source()) {
+        if (m_output == NULL) {
+            parse();
+        }
+        get_reference_values(m_output->root, urls, styles);
+    }
+}
+
+
+void GumboInterface::get_reference_values(GumboNode* node, QStringList &urls, QStringList &styles)
+{
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return;
+    }
+    const GumboVector * attribs = &node->v.element.attributes;
+    for (unsigned int i = 0; i < attribs->length; ++i) {
+        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
+        const char * name = at->name;
+        if ((aHREF == name) || (aSRC == name) || (aPOSTER == name) || (aDATA == name)) {
+            urls.append(QString::fromUtf8(at->value));
+        } else if (strcmp(name, "style") == 0) {
+            styles.append(QString::fromUtf8(at->value));
+        }
+    }
+    if (node->v.element.tag == GUMBO_TAG_STYLE) {
+        styles.append(get_local_text_of_node(node));
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        get_reference_values(static_cast<GumboNode*>(children->data[i]), urls, styles);
     }
-    return attr_vals;
 }
 
 
@@ -786,35 +966,42 @@ QHash<QString,QString> GumboInterface::get_attributes_of_node(GumboNode* node)
 
 QString GumboInterface::get_local_text_of_node(GumboNode* node)
 {
-    QString  node_text;
+    // gather the UTF-8 straight from the tree and only convert it once
+    QByteArray node_text;
+    append_local_text_of_node(node, node_text);
+    return QString::fromUtf8(node_text);
+}
+
+
+void GumboInterface::append_local_text_of_node(GumboNode* node, QByteArray &node_text)
+{
     if (node->type != GUMBO_NODE_ELEMENT) {
-        return node_text;
+        return;
     }
     // handle br tag as special case element tag with a text value
     GumboTag tag = node->v.element.tag;
     if (tag == GUMBO_TAG_BR) {
-        node_text = "\n";
-        return node_text;
+        node_text.append('\n');
+        return;
     }
     GumboVector* children = &node->v.element.children;
     for (unsigned int i = 0; i < children->length; ++i) {
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            node_text += QString::fromUtf8(child->v.text.text);
+            node_text.append(child->v.text.text);
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
             // keep all whitespace to keep as close to original as possible
-            node_text += QString::fromUtf8(child->v.text.text);
+            node_text.append(child->v.text.text);
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            node_text += QString::fromUtf8(child->v.text.text);
+            node_text.append(child->v.text.text);
 
         } else if (child->type == GUMBO_NODE_ELEMENT) {
-            node_text += get_local_text_of_node(child);
+            append_local_text_of_node(child, node_text);
         }
     }
-    return node_text;
 }
 
 
@@ -829,7 +1016,7 @@ QList<GumboNode*> GumboInterface::get_all_nodes_with_tag(GumboTag tag)
 QList<GumboNode*> GumboInterface::get_all_nodes_with_tags(const QList<GumboTag> & tags )
 {
   QList<GumboNode*> nodes;
-  if (!m_source.isEmpty()) {
+  if (has_source()) {
     if (m_output == NULL) {
       parse();
     }
@@ -1078,6 +1265,33 @@ std::string GumboInterface::get_tag_name(GumboNode *node)
 }
 
 
+// known html tag names are static strings inside gumbo so can be
+// wrapped as is, only unknown and svg tag names need working out
+QByteArray GumboInterface::get_tag_name_view(GumboNode *node)
+{
+    if (((node->type == GUMBO_NODE_ELEMENT) || (node->type == GUMBO_NODE_TEMPLATE)) &&
+        (node->v.element.tag != GUMBO_TAG_UNKNOWN) &&
+        (node->v.element.tag_namespace != GUMBO_NAMESPACE_SVG)) {
+        const char * tagname = gumbo_normalized_tagname(node->v.element.tag);
+        return QByteArray::fromRawData(tagname, qstrlen(tagname));
+    }
+    return QByteArray::fromStdString(get_tag_name(node));
+}
+
+
+QByteArray GumboInterface::get_attribute_view(GumboNode *node, const char *attname)
+{
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return QByteArray();
+    }
+    GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, attname);
+    if (!attr) {
+        return QByteArray();
+    }
+    return QByteArray::fromRawData(attr->value, qstrlen(attr->value));
+}
+
+
 // if missing leave it alone
 // if epub3 docytpe use it otherwise set it to epub2 docytpe
 std::string GumboInterface::build_doctype(GumboNode *node)
@@ -1168,63 +1382,97 @@ std::string GumboInterface::build_attributes(GumboAttribute * at, bool no_entiti
 }
 
 
+// categories of an element, only unknown tags need their name looked up
+unsigned int GumboInterface::get_tag_categories(GumboNode* node, const std::string *tagname)
+{
+    static const std::vector<unsigned int> tag_categories = build_tag_category_table();
+    if (((node->type == GUMBO_NODE_ELEMENT) || (node->type == GUMBO_NODE_TEMPLATE)) &&
+        (node->v.element.tag != GUMBO_TAG_UNKNOWN)) {
+        return tag_categories[node->v.element.tag];
+    }
+    if (tagname) {
+        return categories_for_tagname(*tagname);
+    }
+    return categories_for_tagname(get_tag_name(node));
+}
+
+
 // serialize children of a node
 // may be invoked recursively
 
 std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes doupdates) {
-    std::string contents        = "";
-    std::string tagname         = get_tag_name(node);
-    bool no_entity_substitution = in_set(no_entity_sub, tagname);
-    bool keep_whitespace        = in_set(preserve_whitespace, tagname);
-    bool is_inline              = in_set(nonbreaking_inline, tagname);
-    bool is_structural          = in_set(structural_tags, tagname);
+    std::string contents;
+    contents.reserve(m_utf8src.size() + SERIALIZE_SLACK);
+    serialize_contents(node, contents, doupdates);
+    return contents;
+}
+
+
+// appends the serialized children of a node to out
+// may be invoked recursively
+
+void GumboInterface::serialize_contents(GumboNode* node, std::string &out, enum UpdateTypes doupdates) {
+    unsigned int categories     = get_tag_categories(node);
+    bool no_entity_substitution = categories & TAG_NO_ENTITY_SUB;
+    bool keep_whitespace        = categories & TAG_PRESERVE_WHITESPACE;
+    bool is_inline              = categories & TAG_NONBREAKING_INLINE;
+    bool is_structural          = categories & TAG_STRUCTURAL;
 
     // build up result for each child, recursively if need be
     GumboVector* children = &node->v.element.children;
 
     bool inject_newline = false;
-    bool in_head_without_title = (tagname == "head");
+    bool in_head_without_title = ((node->type == GUMBO_NODE_ELEMENT) || (node->type == GUMBO_NODE_TEMPLATE)) &&
+                                 (node->v.element.tag == GUMBO_TAG_HEAD);
 
     for (unsigned int i = 0; i < children->length; ++i) {
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            std::string text;
+            const char * text = child->v.text.text;
+            size_t len = strlen(text);
+            if (inject_newline && (len > 0) && (text[0] == '\n')) {
+                text++;
+                len--;
+            }
+            inject_newline = false;
             if (no_entity_substitution) {
-                text = std::string(child->v.text.text);
+                out.append(text, len);
             } else {
-                text = substitute_xml_entities_into_text(std::string(child->v.text.text));
+                append_with_xml_entities(out, text, len);
             }
-            if (inject_newline && !text.empty() && (text.at(0) == '\n')) text.erase(0,1);
-            inject_newline = false;
-            contents.append(text);
 
         } else if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE) {
-            contents.append(serialize(child, doupdates));
+            serialize(child, out, doupdates);
             inject_newline = false;
-            std::string childname = get_tag_name(child);
-            if (in_head_without_title && (childname == "title")) in_head_without_title = false;
-            if (!is_inline && !keep_whitespace && !in_set(nonbreaking_inline,childname) && is_structural) {
-                contents.append("\n");
+            if (in_head_without_title && (child->v.element.tag == GUMBO_TAG_TITLE)) in_head_without_title = false;
+            if (!is_inline && !keep_whitespace && !(get_tag_categories(child) & TAG_NONBREAKING_INLINE) && is_structural) {
+                out.append("\n");
                 inject_newline = true;
             }
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
             // try to keep all whitespace to keep as close to original as possible
-            std::string wspace = std::string(child->v.text.text);
+            const char * wspace = child->v.text.text;
             if (inject_newline) {
-                newlinetrim(wspace);
+                // drop everything up to and including the newline
+                const char * nl = strchr(wspace, '\n');
+                if (nl) wspace = nl + 1;
                 inject_newline = false;
             }
-            contents.append(wspace);
+            out.append(wspace);
             inject_newline = false;
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            contents.append("<![CDATA[" + std::string(child->v.text.text) + "]]>");
+            out.append("<![CDATA[");
+            out.append(child->v.text.text);
+            out.append("]]>");
             inject_newline = false;
 
         } else if (child->type == GUMBO_NODE_COMMENT) {
-            contents.append("<!--" + std::string(child->v.text.text) + "-->");
+            out.append("<!--");
+            out.append(child->v.text.text);
+            out.append("-->");
  
         } else {
             fprintf(stderr, "unknown element of type: %d\n", child->type); 
@@ -1232,8 +1480,7 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
         }
 
     }
-    if (in_head_without_title) contents.append("<title></title>");
-    return contents;
+    if (in_head_without_title) out.append("<title></title>");
 }
 
 
@@ -1241,25 +1488,42 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
 // may be invoked recursively
 
 std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdates) {
+    std::string results;
+    // the output is about the size of the source so size the buffer once up front
+    results.reserve(m_utf8src.size() + m_newbody.size() + SERIALIZE_SLACK);
+    serialize(node, results, doupdates);
+    return results;
+}
+
+
+// appends a serialized GumboNode to out, the children are written
+// straight into the same buffer instead of being built up separately
+// may be invoked recursively
+
+void GumboInterface::serialize(GumboNode* node, std::string &out, enum UpdateTypes doupdates) {
     // special case the document node
     if (node->type == GUMBO_NODE_DOCUMENT) {
-        std::string results = build_doctype(node);
-        results.append(serialize_contents(node, doupdates));
-        return results;
+        out.append(build_doctype(node));
+        serialize_contents(node, out, doupdates);
+        return;
     }
 
-    std::string close = "";
-    std::string closeTag = "";
-    std::string atts = "";
     std::string tagname            = get_tag_name(node);
-    bool need_special_handling     = in_set(special_handling, tagname);
-    bool is_void_tag               = in_set(void_tags, tagname);
-    bool no_entity_substitution    = in_set(no_entity_sub, tagname);
-    bool is_href_src_tag           = in_set(href_src_tags, tagname);
+    unsigned int categories        = get_tag_categories(node, &tagname);
+    bool need_special_handling     = categories & TAG_SPECIAL_HANDLING;
+    bool is_void_tag               = categories & TAG_VOID;
+    bool no_entity_substitution    = categories & TAG_NO_ENTITY_SUB;
+    bool is_href_src_tag           = categories & TAG_HREF_SRC;
     bool in_xml_ns                 = node->v.element.tag_namespace != GUMBO_NAMESPACE_HTML;
-    // bool is_inline                 = in_set(nonbreaking_inline, tagname);
+
+    if ((doupdates & LinkUpdates) && (tagname == "link") && 
+        (node->parent->type == GUMBO_NODE_ELEMENT) && 
+        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
+      return;
+    }
 
     // build attr string  
+    std::string atts = "";
     const GumboVector * attribs = &node->v.element.attributes;
     for (unsigned int i=0; i< attribs->length; ++i) {
         GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
@@ -1273,57 +1537,66 @@ std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdate
       }
     }
 
+    out.append("<");
+    out.append(tagname);
+    out.append(atts);
+    size_t close_pos = out.size();
+    out.append(is_void_tag ? "/>" : ">");
+    if (need_special_handling) out.append("\n");
+
     // determine contents
-    std::string contents;
+    size_t contents_start = out.size();
 
     if ((tagname == "body") && (doupdates & BodyUpdates)) {
-        contents = m_newbody;
+        out.append(m_newbody);
     } else {
         // serialize your contents
-        contents = serialize_contents(node, doupdates);
+        serialize_contents(node, out, doupdates);
     }
 
-    // determine closing tag type
-    std::string testcontents = contents;
-    ltrim(testcontents);
-    if (is_void_tag || (in_xml_ns && testcontents.empty())) {
-        close = "/";
-    } else {
-        closeTag = "</" + tagname + ">";
+    // determine closing tag type, an xml element with only
+    // whitespace inside is self closed (the whitespace is kept)
+    bool self_closed = is_void_tag;
+    if (!self_closed && in_xml_ns && (out.find_first_not_of(" \n\r\t\v\f", contents_start) == std::string::npos)) {
+        out.insert(close_pos, 1, '/');
+        contents_start++;
+        self_closed = true;
     }
 
     if ((doupdates & StyleUpdates) && (tagname == "style") && 
         (node->parent->type == GUMBO_NODE_ELEMENT) && 
         (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-        contents = update_style_urls(contents);
+        std::string contents = out.substr(contents_start);
+        out.replace(contents_start, std::string::npos, update_style_urls(contents));
     }
 
     if (need_special_handling) {
-        ltrimnewlines(contents);
-        rtrim(contents);
-        contents.append("\n");
-    }
-
-    // build results
-    std::string results;
-
-    if ((doupdates & LinkUpdates) && (tagname == "link") && 
-        (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-      return "";
+        // trim leading newlines and trailing whitespace of the contents
+        size_t first = out.find_first_not_of("\n\r", contents_start);
+        if (first == std::string::npos) {
+            out.resize(contents_start);
+        } else if (first > contents_start) {
+            out.erase(contents_start, first - contents_start);
+        }
+        size_t last = out.find_last_not_of(" \n\r\t\v\f");
+        if ((last == std::string::npos) || (last < contents_start)) {
+            out.resize(contents_start);
+        } else {
+            out.resize(last + 1);
+        }
+        out.append("\n");
     }
 
-    results.append("<"+tagname+atts+close+">");
-    if (need_special_handling) results.append("\n");
-    results.append(contents);
-
     if ((doupdates & LinkUpdates) && (tagname == "head")) {
-        results.append(m_newcsslinks);
+        out.append(m_newcsslinks);
     }
 
-    results.append(closeTag);
-    if (need_special_handling) results.append("\n");
-    return results;
+    if (!self_closed) {
+        out.append("</");
+        out.append(tagname);
+        out.append(">");
+    }
+    if (need_special_handling) out.append("\n");
 }
 
 
@@ -30,6 +30,7 @@
 #include "gumbo.h"
 #include "gumbo_edit.h"
 
+#include <QByteArray>
 #include <QString>
 #include <QList>
 #include <QHash>
@@ -48,6 +49,10 @@ public:
 
     GumboInterface(const QString &source, const QString &version);
     GumboInterface(const QString &source, const QString &version, const QHash<QString, QString> &source_updates);
+
+    // parses already encoded UTF-8 source (see TextResource::GetUtf8Text) as is,
+    // the buffer is shared rather than copied or transcoded again
+    GumboInterface(const QByteArray &utf8source, const QString &version);
     ~GumboInterface();
 
     void    parse();
@@ -92,12 +97,22 @@ public:
     QStringList get_all_values_for_attribute(const QString & attname);
     QHash<QString,QString> get_attributes_of_node(GumboNode* node);
 
+    // the raw href, src, poster and data values and the style text (attributes
+    // and style elements) that perform_source_updates and perform_style_updates
+    // may rewrite, so callers can tell which paths a document refers to
+    void get_all_reference_values(QStringList &urls, QStringList &styles);
+
     // routines for working with nodes with specific tags
     QList<GumboNode*> get_all_nodes_with_tag(GumboTag tag);
     QList<GumboNode*> get_all_nodes_with_tags(const QList<GumboTag> & tags);
 
     // utility routines 
     std::string get_tag_name(GumboNode *node);
+
+    // zero-copy views, they wrap the tree's own bytes (QByteArray::fromRawData) so
+    // comparing them does not allocate but they must not outlive this GumboInterface
+    QByteArray get_tag_name_view(GumboNode *node);
+    static QByteArray get_attribute_view(GumboNode *node, const char *attname); // null if not present
     QString get_local_text_of_node(GumboNode* node);
     QString get_body_text();
 
@@ -126,12 +141,28 @@ private:
 
     QStringList get_properties(GumboNode* node);
 
-    QStringList get_values_for_attr(GumboNode* node, const char* attr_name);
+    void get_values_for_attr(GumboNode* node, const char* attr_name, QStringList &attr_vals);
+
+    void get_reference_values(GumboNode* node, QStringList &urls, QStringList &styles);
+
+    void append_local_text_of_node(GumboNode* node, QByteArray &node_text);
+
+    bool has_source() const;
+
+    void load_utf8src();
 
     std::string serialize(GumboNode* node, enum UpdateTypes doupdates = NoUpdates);
 
     std::string serialize_contents(GumboNode* node, enum UpdateTypes doupdates = NoUpdates);
 
+    // the workers behind the two above, they append to a single output buffer
+    void serialize(GumboNode* node, std::string &out, enum UpdateTypes doupdates);
+
+    void serialize_contents(GumboNode* node, std::string &out, enum UpdateTypes doupdates);
+
+    // returns the TagCategory bits of an element, tagname may be passed if already known
+    unsigned int get_tag_categories(GumboNode* node, const std::string *tagname = NULL);
+
     std::string prettyprint(GumboNode* node, int lvl, const std::string indent_chars);
 
     std::string prettyprint_contents(GumboNode* node, int lvl, const std::string indent_chars);
@@ -164,12 +195,16 @@ private:
 
     void replace_all(std::string &s, const char * s1, const char * s2);
 
+    GumboArena* get_parse_arena();
+
     // Hopefully now unneeded
     // QString fix_self_closing_tags(const QString & source);
 
     QString                         m_source;
     GumboOutput*                    m_output;
-    std::string                     m_utf8src;
+    GumboArena*                     m_arena;
+    QByteArray                      m_utf8src;
+    int                             m_utf8start;
     const QHash<QString, QString> & m_sourceupdates;
     std::string                     m_newcsslinks;
     QString                         m_currentbkpath;
@@ -0,0 +1,318 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QThread>
+#include <QThreadStorage>
+#include <QtEndian>
+
+#include <stdio.h>
+#ifdef Q_OS_WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "Misc/EmbeddedPython.h"
+#include "Misc/PythonWorkerPool.h"
+#include "Misc/SettingsStore.h"
+
+#ifdef Q_OS_WIN32
+#define SIGIL_DUP  _dup
+#define SIGIL_DUP2 _dup2
+#define SIGIL_FILENO _fileno
+#else
+#define SIGIL_DUP  dup
+#define SIGIL_DUP2 dup2
+#define SIGIL_FILENO fileno
+#endif
+
+const QString PythonWorkerPool::PYTHON_WORKER_ARG = "--python-worker";
+
+// both ends of the pipe are the same Sigil binary so any fixed version will do
+static const QDataStream::Version WORKER_STREAM_VERSION = QDataStream::Qt_5_9;
+
+// how long to give a helper to exit on its own once its pipe is closed
+static const int WORKER_SHUTDOWN_MS = 2000;
+
+// how long a helper may go without sending or taking any data before
+// we consider it hung, generous since one job can be a large file
+static const int WORKER_IO_TIMEOUT_MS = 120000;
+
+// no request or reply comes close to this, a larger length means a
+// corrupt frame and must not turn into a huge allocation
+static const quint32 MAX_FRAME_SIZE = 512 * 1024 * 1024;
+
+PythonWorkerPool *PythonWorkerPool::m_instance = 0;
+
+// set once a helper fails to start so we do not keep trying
+static QAtomicInt s_PoolBroken(0);
+
+
+// One helper process owned by (and only ever used from) a single thread
+class PythonWorker
+{
+
+public:
+    PythonWorker() : m_Process(new QProcess()) {}
+
+    ~PythonWorker()
+    {
+        if (m_Process->state() != QProcess::NotRunning) {
+            // closing its request pipe makes the helper leave its loop
+            m_Process->closeWriteChannel();
+            if (!m_Process->waitForFinished(WORKER_SHUTDOWN_MS)) {
+                m_Process->kill();
+                m_Process->waitForFinished(WORKER_SHUTDOWN_MS);
+            }
+        }
+        delete m_Process;
+        PythonWorkerPool::instance()->m_Slots.release();
+    }
+
+    bool start()
+    {
+        m_Process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        m_Process->start(QCoreApplication::applicationFilePath(),
+                         QStringList() << PythonWorkerPool::PYTHON_WORKER_ARG);
+        return m_Process->waitForStarted();
+    }
+
+    bool call(const QByteArray &request, QByteArray &reply)
+    {
+        if (!PythonWorkerPool::WriteFrame(m_Process, request) ||
+            !PythonWorkerPool::ReadFrame(m_Process, reply, true)) {
+            // hung or confused, do not give it a chance to answer later
+            m_Process->kill();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    QProcess *m_Process;
+};
+
+static QThreadStorage<PythonWorker *> s_Worker;
+
+
+PythonWorkerPool *PythonWorkerPool::instance()
+{
+    static QMutex instance_mutex;
+    QMutexLocker locker(&instance_mutex);
+    if (m_instance == 0) {
+        m_instance = new PythonWorkerPool();
+    }
+    return m_instance;
+}
+
+
+PythonWorkerPool::PythonWorkerPool()
+    : m_MaxWorkers(0)
+{
+    SettingsStore settings;
+    m_MaxWorkers = settings.pythonWorkerCount();
+    if (m_MaxWorkers < 0) {
+        m_MaxWorkers = QThread::idealThreadCount();
+    }
+    if (m_MaxWorkers > 0) {
+        m_Slots.release(m_MaxWorkers);
+    }
+}
+
+
+bool PythonWorkerPool::run(const QString &module_name,
+                           const QString &function_name,
+                           const QVariantList &args,
+                           QVariant &result,
+                           int *pRV,
+                           QString &error_traceback)
+{
+    if ((m_MaxWorkers <= 0) || s_PoolBroken.loadAcquire()) {
+        return false;
+    }
+
+    // the GUI thread gains nothing by waiting on another process
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app || (QThread::currentThread() == app->thread())) {
+        return false;
+    }
+
+    PythonWorker *worker = s_Worker.localData();
+    if (!worker) {
+        if (!m_Slots.tryAcquire()) {
+            return false;
+        }
+        // the worker gives its slot back when deleted
+        worker = new PythonWorker();
+        if (!worker->start()) {
+            qDebug() << "Unable to start python worker, running python in-process only";
+            s_PoolBroken.storeRelease(1);
+            delete worker;
+            return false;
+        }
+        s_Worker.setLocalData(worker);
+    }
+
+    QByteArray request;
+    QDataStream out(&request, QIODevice::WriteOnly);
+    out.setVersion(WORKER_STREAM_VERSION);
+    out << module_name << function_name << args;
+
+    QByteArray reply;
+    if (!worker->call(request, reply)) {
+        // the helper died, hung or garbled its reply, drop it and let the caller
+        // run the job here, the next job in this thread starts a new helper
+        s_Worker.setLocalData(0);
+        return false;
+    }
+
+    QDataStream in(reply);
+    in.setVersion(WORKER_STREAM_VERSION);
+    qint32 rv = 0;
+    in >> rv >> error_traceback >> result;
+    if (in.status() != QDataStream::Ok) {
+        s_Worker.setLocalData(0);
+        return false;
+    }
+    *pRV = rv;
+    return true;
+}
+
+
+// frames are a big endian 32 bit length followed by that many bytes
+bool PythonWorkerPool::ReadFrame(QIODevice *device, QByteArray &frame, bool wait_for_data)
+{
+    uchar header[4];
+    QByteArray data;
+    char *dest = reinterpret_cast<char *>(header);
+    qint64 needed = 4;
+    qint64 got = 0;
+    bool have_header = false;
+
+    while (true) {
+        while (got < needed) {
+            qint64 n = device->read(dest + got, needed - got);
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                // a blocking read only returns nothing at end of file
+                if (!wait_for_data || !device->waitForReadyRead(WORKER_IO_TIMEOUT_MS)) {
+                    return false;
+                }
+            }
+            got += n;
+        }
+        if (have_header) {
+            break;
+        }
+        have_header = true;
+        quint32 length = qFromBigEndian<quint32>(header);
+        if (length > MAX_FRAME_SIZE) {
+            return false;
+        }
+        needed = length;
+        data.resize(length);
+        dest = data.data();
+        got = 0;
+    }
+    frame = data;
+    return true;
+}
+
+
+bool PythonWorkerPool::WriteFrame(QIODevice *device, const QByteArray &frame)
+{
+    if (quint32(frame.size()) > MAX_FRAME_SIZE) {
+        return false;
+    }
+    uchar header[4];
+    qToBigEndian<quint32>(frame.size(), header);
+    if (device->write(reinterpret_cast<const char *>(header), 4) != 4) {
+        return false;
+    }
+    if (device->write(frame) != frame.size()) {
+        return false;
+    }
+    while (device->bytesToWrite() > 0) {
+        if (!device->waitForBytesWritten(WORKER_IO_TIMEOUT_MS)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+int PythonWorkerPool::RunWorker()
+{
+    // keep the reply channel private so anything the python code prints
+    // ends up on stderr instead of corrupting the replies
+    int reply_fd = SIGIL_DUP(SIGIL_FILENO(stdout));
+    SIGIL_DUP2(SIGIL_FILENO(stderr), SIGIL_FILENO(stdout));
+#ifdef Q_OS_WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(reply_fd, _O_BINARY);
+#endif
+
+    QFile requests;
+    QFile replies;
+    if (!requests.open(SIGIL_FILENO(stdin), QIODevice::ReadOnly | QIODevice::Unbuffered) ||
+        !replies.open(reply_fd, QIODevice::WriteOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle)) {
+        return 1;
+    }
+
+    // nobody is around to see a message box
+    EmbeddedPython::setHeadless(true);
+    EmbeddedPython *epython = EmbeddedPython::instance();
+
+    QByteArray frame;
+    while (ReadFrame(&requests, frame, false)) {
+        QDataStream in(frame);
+        in.setVersion(WORKER_STREAM_VERSION);
+        QString module_name;
+        QString function_name;
+        QVariantList args;
+        in >> module_name >> function_name >> args;
+
+        int rv = 0;
+        QString error_traceback;
+        QVariant res = epython->runInPython(module_name, function_name, args, &rv, error_traceback);
+
+        QByteArray reply;
+        QDataStream out(&reply, QIODevice::WriteOnly);
+        out.setVersion(WORKER_STREAM_VERSION);
+        out << (qint32) rv << error_traceback << res;
+        if (!WriteFrame(&replies, reply)) {
+            break;
+        }
+    }
+    return 0;
+}
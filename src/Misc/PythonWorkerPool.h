@@ -0,0 +1,89 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PYTHONWORKERPOOL_H
+#define PYTHONWORKERPOOL_H
+
+#include <QString>
+#include <QVariant>
+#include <QSemaphore>
+
+class QIODevice;
+
+/**
+ * Pool of persistent helper processes, each one a headless copy of
+ * Sigil running its own embedded Python interpreter.
+ *
+ * The in-process interpreter can only run one job at a time (GIL plus
+ * the EmbeddedPython mutex), so independent per-file jobs started from
+ * QtConcurrent threads are handed to these helpers instead. Every
+ * non-GUI thread lazily gets its own helper (a QProcess may only be
+ * used from the thread that owns it), and the number of live helpers
+ * is capped by the python worker count preference.
+ *
+ * Requests and replies are length prefixed QDataStream frames so only
+ * plain data (strings, numbers, byte arrays and lists of them) can be
+ * passed; Python objects can not cross the process boundary.
+ */
+class PythonWorkerPool
+{
+
+public:
+    static PythonWorkerPool *instance();
+
+    /**
+     * Run module_name.function_name(*args) in this thread's helper.
+     *
+     * @return false when no helper is available (GUI thread, pool
+     *         disabled or full, helper failed) in which case the caller
+     *         should run the call in-process instead.
+     */
+    bool run(const QString &module_name,
+             const QString &function_name,
+             const QVariantList &args,
+             QVariant &result,
+             int *pRV,
+             QString &error_traceback);
+
+    /**
+     * Main loop of a helper process, started when Sigil is launched
+     * with PYTHON_WORKER_ARG. Returns once the request pipe closes.
+     */
+    static int RunWorker();
+
+    static const QString PYTHON_WORKER_ARG;
+
+private:
+    PythonWorkerPool();
+
+    friend class PythonWorker;
+
+    static bool ReadFrame(QIODevice *device, QByteArray &frame, bool wait_for_data);
+    static bool WriteFrame(QIODevice *device, const QByteArray &frame);
+
+    QSemaphore m_Slots;
+    int m_MaxWorkers;
+
+    static PythonWorkerPool *m_instance;
+};
+
+#endif // PYTHONWORKERPOOL_H
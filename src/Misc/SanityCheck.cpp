@@ -0,0 +1,339 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QStringRef>
+
+#include "Misc/SanityCheck.h"
+
+static const int MAX_TAG_LEN = 20;
+
+static const QStringList VOID_TAGS = QStringList() << "area" << "base" << "basefont" << "bgsound" << "br"
+                                                   << "col" << "command" << "embed" << "event-source"
+                                                   << "frame" << "hr" << "img" << "input" << "keygen"
+                                                   << "link" << "menuitem" << "meta" << "param" << "source"
+                                                   << "spacer" << "track" << "wbr" << "mbp:pagebreak";
+
+
+SanityCheck::SanityCheck(const QString &source)
+    : m_Source(source),
+      m_Pos(0),
+      m_PrevPos(0),
+      m_Line(1),
+      m_Col(0),
+      m_TagLine(-1),
+      m_TagCol(-1),
+      m_HtmlCount(0),
+      m_BodyCount(0),
+      m_HeadCount(0),
+      m_DoctypeCount(0),
+      m_HasError(false)
+{
+}
+
+
+QList<SanityCheck::Error> SanityCheck::check()
+{
+    ParseAll();
+    if (!m_HasError) {
+        if (m_HtmlCount != 1) {
+            AddError(1, 0, "Missing or multiple \"html\" tags");
+        }
+        if (m_BodyCount != 1) {
+            AddError(1, 0, "Missing or multiple \"body\" tags");
+        }
+        if (m_HeadCount != 1) {
+            AddError(1, 0, "Missing or multiple \"head\" tags");
+        }
+    }
+    return m_Errors;
+}
+
+
+void SanityCheck::AddError(int line, int col, const QString &message)
+{
+    Error error;
+    error.line = line;
+    error.col = col;
+    error.message = message;
+    m_Errors.append(error);
+    m_HasError = true;
+}
+
+
+void SanityCheck::AddTagError(const QString &message)
+{
+    AddError(m_TagLine, m_TagCol, message);
+}
+
+
+// walk a segment keeping track of line and column (in code points just
+// like python) and optionally flag any < or > found in plain text
+void SanityCheck::Advance(const QStringRef &segment, bool check_text)
+{
+    int n = segment.length();
+    for (int i = 0; i < n; i++) {
+        QChar c = segment.at(i);
+        if (c.isLowSurrogate() && (i > 0) && segment.at(i - 1).isHighSurrogate()) {
+            continue;
+        }
+        if (check_text && ((c == '<') || (c == '>'))) {
+            AddError(m_Line, m_Col, "illegal character in text");
+        }
+        m_Col++;
+        if (c == '\n') {
+            m_Line++;
+            m_Col = 0;
+        }
+    }
+}
+
+
+// get either the leading text or the next tag, returns false at the end
+bool SanityCheck::ParseML(QString &text, bool &is_tag)
+{
+    int n = m_Source.length();
+    m_PrevPos = m_Pos;
+    int p = m_Pos;
+    if (p >= n) {
+        return false;
+    }
+    if (m_Source.at(p) != '<') {
+        int res = m_Source.indexOf('<', p);
+        if (res == -1) {
+            res = n;
+        }
+        m_Pos = res;
+        text = m_Source.mid(p, res - p);
+        is_tag = false;
+        return true;
+    }
+    int te;
+    // comments and cdata sections may span lines and hold markup
+    if (m_Source.midRef(p, 4) == "<!--") {
+        te = m_Source.indexOf("-->", p + 1);
+        if (te != -1) {
+            te = te + 2;
+        }
+    } else if (m_Source.midRef(p, 9) == "<![CDATA[") {
+        te = m_Source.indexOf("]]>", p + 9);
+        if (te != -1) {
+            te = te + 2;
+        }
+    } else {
+        te = m_Source.indexOf('>', p + 1);
+        int ntb = m_Source.indexOf('<', p + 1);
+        if ((ntb != -1) && (ntb < te)) {
+            m_Pos = ntb;
+            text = m_Source.mid(p, ntb - p);
+            is_tag = false;
+            return true;
+        }
+    }
+    m_Pos = te + 1;
+    // an unterminated tag comes back empty and is reported by ParseTag
+    text = (te == -1) ? QString() : m_Source.mid(p, te + 1 - p);
+    is_tag = true;
+    return true;
+}
+
+
+// identify the tag's name and type, only attribute syntax is checked
+SanityCheck::TagType SanityCheck::ParseTag(const QString &s, QString &tname)
+{
+    int taglen = s.length();
+    int p = 1;
+    TagType ttype = TagType_None;
+    while (p < taglen && s.at(p) == ' ') p++;
+    if (p < taglen && s.at(p) == '/') {
+        ttype = TagType_End;
+        p++;
+        while (p < taglen && s.at(p) == ' ') p++;
+    }
+    int b = p;
+    // special cases where there may be no spaces to delimit the name
+    if (s.midRef(b, 3) == "!--") {
+        tname = "!--";
+        return TagType_Comment;
+    }
+    if (s.midRef(b, 8) == "![CDATA[") {
+        tname = "![CDATA[";
+        return TagType_CData;
+    }
+    if (s.midRef(b, 1) == "?") {
+        tname = "?";
+        return TagType_PI;
+    }
+    while (true) {
+        if (p < taglen) {
+            QChar c = s.at(p);
+            if ((c == '>') || (c == '/') || (c == ' ') || (c == '\f') || (c == '\t') || (c == '\r') || (c == '\n')) {
+                break;
+            }
+        }
+        p++;
+        if (((p - b) > MAX_TAG_LEN) || (p >= taglen)) {
+            AddTagError("Tag name not properly delimited: \"" + s.mid(b, p - b) + "\"");
+            return TagType_None;
+        }
+    }
+    tname = s.mid(b, p - b).toLower();
+    if (tname.contains('\'') || tname.contains('"')) {
+        AddTagError("Tag attribute not properly space delimited: \"" + s.mid(b, p - b) + "\"");
+        return TagType_None;
+    }
+    if (tname == "!doctype") {
+        tname = "!DOCTYPE";
+        return TagType_Doctype;
+    }
+    if (ttype == TagType_End) {
+        return ttype;
+    }
+
+    // walk any attributes
+    while (s.indexOf('=', p) != -1) {
+        while (p < taglen && s.at(p) == ' ') p++;
+        b = p;
+        while (s.at(p) != '=') p++;
+        QString aname = s.mid(b, p - b).toLower();
+        int e = aname.length();
+        while (e > 0 && aname.at(e - 1) == ' ') e--;
+        aname.truncate(e);
+        p++;
+        while (p < taglen && s.at(p) == ' ') p++;
+        if (p < taglen && (s.at(p) == '"' || s.at(p) == '\'')) {
+            QChar qt = s.at(p);
+            p++;
+            while ((p >= taglen) || (s.at(p) != qt)) {
+                p++;
+                if (p >= taglen) {
+                    AddTagError("Attribute \"" + aname + "\" has unmatched quotes on attribute value");
+                    return TagType_None;
+                }
+            }
+            p++;
+        } else {
+            while ((p >= taglen) || ((s.at(p) != '>') && (s.at(p) != '/') && (s.at(p) != ' '))) {
+                p++;
+                if (p >= taglen) {
+                    AddTagError("Attribute \"" + aname + "\" has unterminated attribute value");
+                    return TagType_None;
+                }
+            }
+        }
+    }
+    if (s.indexOf('/', p) >= 0) {
+        return TagType_Single;
+    }
+    return TagType_Begin;
+}
+
+
+void SanityCheck::ParseAll()
+{
+    QString text;
+    bool is_tag = false;
+    while (!m_HasError && ParseML(text, is_tag)) {
+        QString tp = m_TagPath.join(".");
+        if (!is_tag) {
+            Advance(QStringRef(&text), true);
+            continue;
+        }
+
+        m_TagLine = m_Line;
+        m_TagCol = m_Col;
+        if (m_Pos > m_PrevPos) {
+            Advance(m_Source.midRef(m_PrevPos, m_Pos - m_PrevPos), false);
+        }
+
+        QString tname;
+        TagType ttype = ParseTag(text, tname);
+        if (m_HasError) {
+            break;
+        }
+
+        // basic structure sanity check
+        if ((tname == "html") && (ttype == TagType_Begin)) {
+            m_HtmlCount++;
+            if (m_BodyCount > 0) {
+                AddTagError("Tag \"html\" found after \"body\"");
+                break;
+            }
+        }
+        if ((tname == "body") && (ttype == TagType_Begin)) {
+            m_BodyCount++;
+            if (m_HtmlCount == 0) {
+                AddTagError("Tag \"body\" found before \"html\"");
+                break;
+            }
+        }
+        if ((tname == "head") && (ttype == TagType_Begin)) {
+            m_HeadCount++;
+            if (m_BodyCount > 0) {
+                AddTagError("Tag \"head\" found after \"body\"");
+                break;
+            }
+        }
+        if ((tname == "p") && (ttype == TagType_Begin) && m_TagPath.contains("p")) {
+            AddTagError("Can not nest a \"p\" tag inside another \"p\" tag");
+            break;
+        }
+        if (tname == "!DOCTYPE") {
+            m_DoctypeCount++;
+            if (m_DoctypeCount > 1) {
+                AddTagError("Multiple DOCTYPE declarations found");
+                break;
+            }
+            if (m_HtmlCount > 0) {
+                AddTagError("A DOCTYPE must come before the \"html\" tag");
+                break;
+            }
+        }
+
+        // validate tag nesting
+        if (ttype == TagType_End) {
+            if (m_TagPath.isEmpty()) {
+                AddTagError("Improperly nested tags: parsing end tag \"" + tname + "\" but no tags are open");
+                break;
+            }
+            if (m_TagPath.last() != tname) {
+                std::pair<int, int> last_pos = m_TagPositions.last();
+                AddTagError("Improperly nested tags: parsing end tag \"" + tname +
+                            "\" but current parse path is \"" + tp + "\". See line " +
+                            QString::number(last_pos.first) + " col " + QString::number(last_pos.second));
+                break;
+            }
+        }
+
+        // validate void tags are self-closed
+        if ((ttype == TagType_End) && VOID_TAGS.contains(tname)) {
+            AddTagError("Void tag: " + tname + " has an illegal ending tag");
+            break;
+        }
+
+        if (ttype == TagType_Begin) {
+            m_TagPath.append(tname);
+            m_TagPositions.append(std::make_pair(m_TagLine, m_TagCol));
+        } else if (ttype == TagType_End) {
+            m_TagPath.removeLast();
+            m_TagPositions.removeLast();
+        }
+    }
+}
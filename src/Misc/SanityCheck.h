@@ -0,0 +1,98 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef SANITYCHECK_H
+#define SANITYCHECK_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <utility>
+
+/**
+ * Quick structural sanity check of xhtml source.
+ *
+ * Native port of python3lib/sanitycheck.py: it reports the same
+ * problems (improper nesting, illegal characters in text, bad tag
+ * names and attributes, missing html/head/body) at the same line and
+ * column, but works directly on in-memory text and holds no locks, so
+ * any number of files can be checked in parallel.
+ */
+class SanityCheck
+{
+
+public:
+    struct Error {
+        int line;
+        int col;
+        QString message;
+    };
+
+    SanityCheck(const QString &source);
+
+    /**
+     * Runs the check.
+     *
+     * @return The problems found, empty if the source passed.
+     */
+    QList<Error> check();
+
+private:
+    enum TagType {
+        TagType_None,
+        TagType_Begin,
+        TagType_End,
+        TagType_Single,
+        TagType_Comment,
+        TagType_Doctype,
+        TagType_CData,
+        TagType_PI
+    };
+
+    void ParseAll();
+    bool ParseML(QString &text, bool &is_tag);
+    TagType ParseTag(const QString &tag, QString &tname);
+    void Advance(const QStringRef &segment, bool check_text);
+    void AddError(int line, int col, const QString &message);
+    void AddTagError(const QString &message);
+
+    QString m_Source;
+    int m_Pos;
+    int m_PrevPos;
+    int m_Line;
+    int m_Col;
+    int m_TagLine;
+    int m_TagCol;
+
+    int m_HtmlCount;
+    int m_BodyCount;
+    int m_HeadCount;
+    int m_DoctypeCount;
+
+    QStringList m_TagPath;
+    QList<std::pair<int, int> > m_TagPositions;
+
+    bool m_HasError;
+    QList<Error> m_Errors;
+};
+
+#endif // SANITYCHECK_H
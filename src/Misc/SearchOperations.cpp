@@ -20,8 +20,10 @@
 *************************************************************************/
 
 #include <signal.h>
+#include <functional>
 
 #include <QtCore/QtCore>
+#include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QProgressDialog>
 
@@ -41,18 +43,26 @@ int SearchOperations::CountInFiles(const QString &search_regex,
                                    SearchType search_type,
                                    bool check_spelling)
 {
-    QProgressDialog progress(QObject::tr("Counting occurrences.."), 0, 0, resources.count(), Utility::GetMainWindow());
-    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    // Count sequentially in order to see if occassional crashes are due to threading
-    int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += CountInFile(search_regex, resource, search_type, check_spelling);
+    if (check_spelling) {
+        QProgressDialog progress(QObject::tr("Counting occurrences.."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+        progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+        int progress_value = 0;
+        progress.setValue(progress_value);
+        int count = 0;
+        // The spellchecker is not thread safe so count misspellings sequentially
+        foreach(Resource * resource, resources) {
+            if (progress.wasCanceled()) {
+                break;
+            }
+            progress.setValue(progress_value++);
+            qApp->processEvents();
+            count += CountInFile(search_regex, resource, search_type, check_spelling);
+        }
+        return count;
     }
-    return count;
+
+    // A single search is simply a batch of one
+    return CountAllInFiles(QStringList() << search_regex, resources, search_type).at(0);
 }
 
 
@@ -61,18 +71,158 @@ int SearchOperations::ReplaceInAllFIles(const QString &search_regex,
                                         QList<Resource *> resources,
                                         SearchType search_type)
 {
-    QProgressDialog progress(QObject::tr("Replacing search term..."), 0, 0, resources.count(), Utility::GetMainWindow());
+    SearchReplace search;
+    search.search_regex = search_regex;
+    search.replacement = replacement;
+    return ReplaceAllInAllFiles(QList<SearchReplace>() << search, resources, search_type).at(0);
+}
+
+
+QList<int> SearchOperations::CountAllInFiles(const QStringList &search_regexes,
+                                             QList<Resource *> resources,
+                                             SearchType search_type)
+{
+    QProgressDialog progress(QObject::tr("Counting occurrences.."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
     progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    // Replace sequentially in order to see if occassional crashes are due to threading
-    int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += ReplaceInFile(search_regex, replacement, resource, search_type);
+    progress.setValue(0);
+    // Hold on to every compiled expression until the workers finish
+    QList<QSharedPointer<SPCRE> > compiled;
+    QList<SPCRE *> spcres;
+    foreach(QString search_regex, search_regexes) {
+        compiled.append(PCRECache::instance()->getObject(search_regex));
+        spcres.append(compiled.last().data());
+    }
+    QFutureWatcher<QList<int> > watcher;
+    watcher.setFuture(QtConcurrent::mapped(resources, std::bind(CountRegexesInFile, std::placeholders::_1, spcres, search_type)));
+    WaitWithProgress(watcher, progress);
+    // If canceled these are the counts from the files finished so far
+    QList<int> counts;
+    for (int i = 0; i < search_regexes.count(); ++i) {
+        counts.append(0);
+    }
+    foreach(QList<int> file_counts, watcher.future().results()) {
+        AccumulateCounts(counts, file_counts);
+    }
+    return counts;
+}
+
+
+QList<int> SearchOperations::ReplaceAllInAllFiles(const QList<SearchReplace> &searches,
+                                                  QList<Resource *> resources,
+                                                  SearchType search_type)
+{
+    QProgressDialog progress(QObject::tr("Replacing search term..."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+    progress.setValue(0);
+    QList<QSharedPointer<SPCRE> > compiled;
+    QList<SPCRE *> spcres;
+    QStringList replacements;
+    QList<int> counts;
+    foreach(SearchReplace search, searches) {
+        compiled.append(PCRECache::instance()->getObject(search.search_regex));
+        spcres.append(compiled.last().data());
+        replacements.append(search.replacement);
+        counts.append(0);
+    }
+    QFutureWatcher<FileBatchReplacement> watcher;
+    watcher.setFuture(QtConcurrent::mapped(resources, std::bind(ComputeBatchReplaceInFile, std::placeholders::_1, spcres, replacements, search_type)));
+
+    if (!WaitWithProgress(watcher, progress)) {
+        // Nothing has been changed yet
+        return counts;
+    }
+
+    // Now set all of the new texts in one batch from the GUI thread
+    foreach(FileBatchReplacement file_replacement, watcher.future().results()) {
+        if (file_replacement.new_text.isNull()) {
+            continue;
+        }
+        QWriteLocker locker(&file_replacement.resource->GetLock());
+        TextResource *text_resource = qobject_cast<TextResource *>(file_replacement.resource);
+        if (text_resource->GetTextRevision() != file_replacement.text_revision) {
+            // The file changed after we read it so redo it with its current text
+            file_replacement = ComputeBatchReplaceInFile(file_replacement.resource, spcres, replacements, search_type);
+            if (file_replacement.new_text.isNull()) {
+                continue;
+            }
+        }
+        text_resource->SetText(file_replacement.new_text);
+        AccumulateCounts(counts, file_replacement.counts);
+    }
+    return counts;
+}
+
+
+bool SearchOperations::WaitWithProgress(QFutureWatcherBase &watcher, QProgressDialog &progress)
+{
+    QEventLoop loop;
+    QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+    QObject::connect(&watcher, SIGNAL(progressValueChanged(int)), &progress, SLOT(setValue(int)));
+    QObject::connect(&progress, SIGNAL(canceled()), &watcher, SLOT(cancel()));
+
+    // The future may have finished before we connected to it
+    if (!watcher.isFinished()) {
+        loop.exec();
+    }
+    watcher.waitForFinished();
+    return !watcher.isCanceled();
+}
+
+
+QList<int> SearchOperations::CountRegexesInFile(Resource *resource,
+        const QList<SPCRE *> &spcres,
+        SearchType search_type)
+{
+    QList<int> counts;
+    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+
+    if (search_type != SearchOperations::CodeViewSearch || !html_resource) {
+        //TODO: BookViewSearch and other text files
+        return counts;
+    }
+
+    QReadLocker locker(&resource->GetLock());
+    const QString text = html_resource->GetText();
+    foreach(SPCRE *spcre, spcres) {
+        counts.append(spcre->getEveryMatchInfo(text).count());
+    }
+    return counts;
+}
+
+
+// the new text is left null when no search matched, files that are
+// not searched have no counts at all
+SearchOperations::FileBatchReplacement SearchOperations::ComputeBatchReplaceInFile(Resource *resource,
+        const QList<SPCRE *> &spcres,
+        const QStringList &replacements,
+        SearchType search_type)
+{
+    FileBatchReplacement file_replacement;
+    file_replacement.resource = resource;
+    file_replacement.text_revision = -1;
+    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+
+    if (search_type != SearchOperations::CodeViewSearch || !html_resource) {
+        //TODO: BookViewSearch and other text files
+        return file_replacement;
+    }
+
+    QReadLocker locker(&resource->GetLock());
+    // Read the revision before the text so a change in between is caught
+    file_replacement.text_revision = html_resource->GetTextRevision();
+    QString text = html_resource->GetText();
+    bool changed = false;
+    for (int i = 0; i < spcres.count(); ++i) {
+        // each search sees the text as left by the ones before it
+        int count;
+        std::tie(text, count) = PerformGlobalReplace(text, spcres.at(i), replacements.at(i));
+        file_replacement.counts.append(count);
+        changed = changed || (count > 0);
+    }
+    if (changed) {
+        file_replacement.new_text = text;
     }
-    return count;
+    return file_replacement;
 }
 
 
@@ -183,21 +333,23 @@ std::tuple<QString, int> SearchOperations::PerformGlobalReplace(const QString &t
         const QString &search_regex,
         const QString &replacement)
 {
-    QString new_text = text;
-    int count = 0;
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
-    QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+    return PerformGlobalReplace(text, spcre.data(), replacement);
+}
 
-    for (int i =  match_info.count() - 1; i >= 0; i--) {
-        QString match_segement = Utility::Substring(match_info.at(i).offset.first, match_info.at(i).offset.second, new_text);
-        QString replacement_text;
 
-        if (spcre->replaceText(match_segement, match_info.at(i).capture_groups_offsets, replacement, replacement_text)) {
-            new_text.replace(match_info.at(i).offset.first, match_info.at(i).offset.second - match_info.at(i).offset.first, replacement_text);
-            count++;
-        }
+std::tuple<QString, int> SearchOperations::PerformGlobalReplace(const QString &text,
+        SPCRE *spcre,
+        const QString &replacement)
+{
+    QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+
+    if (match_info.isEmpty()) {
+        return std::make_tuple(text, 0);
     }
 
+    QString new_text;
+    int count = spcre->replaceEveryMatch(text, match_info, replacement, new_text);
     return std::make_tuple(new_text, count);
 }
 
@@ -209,7 +361,7 @@ std::tuple<QString, int> SearchOperations::PerformHTMLSpellCheckReplace(const QS
     QString new_text = text;
     int count = 0;
     int offset = 0;
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     QList<HTMLSpellCheck::MisspelledWord> check_spelling = HTMLSpellCheck::GetMisspelledWords(text, 0, text.count(), search_regex);
     foreach(HTMLSpellCheck::MisspelledWord misspelled_word, check_spelling) {
         SPCRE::MatchInfo match_info = spcre->getFirstMatchInfo(misspelled_word.text);
@@ -232,3 +384,11 @@ void SearchOperations::Accumulate(int &first, const int &second)
 {
     first += second;
 }
+
+
+void SearchOperations::AccumulateCounts(QList<int> &totals, const QList<int> &counts)
+{
+    for (int i = 0; i < counts.count(); ++i) {
+        totals[i] += counts.at(i);
+    }
+}
@@ -26,6 +26,9 @@
 class Resource;
 class TextResource;
 class HTMLResource;
+class SPCRE;
+class QFutureWatcherBase;
+class QProgressDialog;
 
 class SearchOperations
 {
@@ -54,13 +57,71 @@ public:
                                  QList<Resource *> resources,
                                  SearchType search_type);
 
+    /**
+     * One search of a saved search group.
+     */
+    struct SearchReplace {
+        QString search_regex;
+        QString replacement;
+    };
+
+    /**
+     * Counts the matches of every regex, reading each file once
+     * for all of them. Files are counted in parallel.
+     *
+     * @return The number of matches of each regex, in order.
+     */
+    static QList<int> CountAllInFiles(const QStringList &search_regexes,
+                                      QList<Resource *> resources,
+                                      SearchType search_type);
+
+    /**
+     * Applies the searches in order to every file, each file being read
+     * and having its text set only once however many searches there are.
+     * Files are processed in parallel.
+     *
+     * @return The number of replacements made by each search, in order.
+     */
+    static QList<int> ReplaceAllInAllFiles(const QList<SearchReplace> &searches,
+                                           QList<Resource *> resources,
+                                           SearchType search_type);
+
 private:
 
+    /**
+     * The outcome of a batch of replaces on one file computed off the
+     * GUI thread, with the number of replacements made by each search.
+     * The new text is only set once every file has been processed.
+     */
+    struct FileBatchReplacement {
+        Resource *resource;
+        QString new_text;
+        QList<int> counts;
+        int text_revision;
+    };
+
+    /**
+     * Runs the event loop until the watched future finishes,
+     * keeping the progress dialog updated.
+     *
+     * @return \c false if the user canceled the operation.
+     */
+    static bool WaitWithProgress(QFutureWatcherBase &watcher, QProgressDialog &progress);
+
     static int CountInFile(const QString &search_regex,
                            Resource *resource,
                            SearchType search_type,
                            bool check_spelling);
 
+    static QList<int> CountRegexesInFile(Resource *resource,
+                                         const QList<SPCRE *> &spcres,
+                                         SearchType search_type);
+
+    static FileBatchReplacement ComputeBatchReplaceInFile(Resource *resource,
+                                                          const QList<SPCRE *> &spcres,
+                                                          const QStringList &replacements,
+                                                          SearchType search_type);
+
 
     static int CountInHTMLFile(const QString &search_regex,
                                HTMLResource *html_resource,
@@ -89,11 +150,17 @@ private:
             const QString &search_regex,
             const QString &replacement);
 
+    static std::tuple<QString, int> PerformGlobalReplace(const QString &text,
+            SPCRE *spcre,
+            const QString &replacement);
+
     static std::tuple<QString, int> PerformHTMLSpellCheckReplace(const QString &text,
             const QString &search_regex,
             const QString &replacement);
 
     static void Accumulate(int &first, const int &second);
+
+    static void AccumulateCounts(QList<int> &totals, const QList<int> &counts);
 };
 
 #endif // SEARCHOPERATIONS_H
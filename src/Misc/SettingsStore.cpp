@@ -127,6 +127,7 @@ static QString KEY_SPECIAL_CHARACTER_FONT_FAMILY = SETTINGS_GROUP + "/" + "speci
 static QString KEY_SPECIAL_CHARACTER_FONT_SIZE = SETTINGS_GROUP + "/" + "special_character_font_size";
 static QString KEY_MAIN_MENU_ICON_SIZE = SETTINGS_GROUP + "/" + "main_menu_icon_size";
 static QString KEY_CLIPBOARD_HISTORY_LIMIT = SETTINGS_GROUP + "/" + "clipboard_history_limit";
+static QString KEY_PYTHON_WORKER_COUNT = SETTINGS_GROUP + "/" + "python_worker_count";
 
 SettingsStore::SettingsStore()
     : QSettings(Utility::DefinePrefsDir() + "/sigil.ini", QSettings::IniFormat)
@@ -470,6 +471,13 @@ int SettingsStore::clipboardHistoryLimit()
     //return value(KEY_CLIPBOARD_HISTORY_LIMIT, CLIPBOARD_HISTORY_MAX).toInt();
 }
 
+int SettingsStore::pythonWorkerCount()
+{
+    clearSettingsGroup();
+    // Defaults to 0 (all python in-process), -1 is one helper per core
+    return value(KEY_PYTHON_WORKER_COUNT, 0).toInt();
+}
+
 void SettingsStore::setDefaultMetadataLang(const QString &lang)
 {
     clearSettingsGroup();
@@ -773,6 +781,12 @@ void SettingsStore::setClipboardHistoryLimit(int limit)
     setValue(KEY_CLIPBOARD_HISTORY_LIMIT, limit);
 }
 
+void SettingsStore::setPythonWorkerCount(int count)
+{
+    clearSettingsGroup();
+    setValue(KEY_PYTHON_WORKER_COUNT, count);
+}
+
 void SettingsStore::clearAppearanceSettings()
 {
     clearSettingsGroup();
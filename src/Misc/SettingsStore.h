@@ -244,6 +244,14 @@ public:
      */
     int clipboardHistoryLimit();
 
+    /**
+     * How many helper processes may run embedded python jobs in parallel.
+     * -1 one per core
+     *  0 default, disabled, run all python in-process
+     *  1+ limit to this number
+     */
+    int pythonWorkerCount();
+
     /**
      * Clear all Preview, Code View and Special Characters settings back to their defaults.
      */
@@ -392,6 +400,11 @@ public slots:
      */
     void setClipboardHistoryLimit(int limit);
 
+    /**
+     * Set the number of python helper processes (see pythonWorkerCount)
+     */
+    void setPythonWorkerCount(int count);
+
 private:
     /**
      * Ensures there is not an open settings group which will cause the settings
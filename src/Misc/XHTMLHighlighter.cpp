@@ -67,10 +67,15 @@ XHTMLHighlighter::XHTMLHighlighter(bool checkSpelling, QObject *parent)
     SetRules();
 }
 
-void XHTMLHighlighter::SetRules()
+void XHTMLHighlighter::RefreshSpellCheckSetting()
 {
-    m_Rules.clear();
+    SettingsStore settings;
+    m_enableSpellCheck = settings.spellCheck();
+}
 
+void XHTMLHighlighter::SetRules()
+{
+    RefreshSpellCheckSetting();
     SettingsStore settings;
     if (Utility::IsDarkMode()) {
         m_codeViewAppearance = settings.codeViewDarkAppearance();
@@ -99,49 +104,41 @@ void XHTMLHighlighter::SetRules()
     // use the same color as for entities but as an underline since they are "spaces"
     special_space_format  .setUnderlineColor(m_codeViewAppearance.xhtml_entity_color);
     special_space_format  .setUnderlineStyle(QTextCharFormat::DashUnderline);
-    HighlightingRule rule;
-    rule.pattern = QRegularExpression(DOCTYPE_BEGIN);
-    rule.format  = doctype_format;
-    m_Rules[ "DOCTYPE_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_ELEMENT_BEGIN);
-    rule.format  = html_format;
-    m_Rules[ "HTML_ELEMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_ELEMENT_END);
-    rule.format  = html_format;
-    m_Rules[ "HTML_ELEMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(HTML_COMMENT_BEGIN);
-    rule.format  = html_comment_format;
-    m_Rules[ "HTML_COMMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_COMMENT_END);
-    rule.format  = html_comment_format;
-    m_Rules[ "HTML_COMMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(CSS_BEGIN);
-    rule.format  = css_format;
-    m_Rules[ "CSS_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(CSS_END);
-    rule.format  = css_format;
-    m_Rules[ "CSS_END" ] = rule;
-    rule.pattern = QRegularExpression(CSS_COMMENT_BEGIN);
-    rule.format  = css_comment_format;
-    m_Rules[ "CSS_COMMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(CSS_COMMENT_END);
-    rule.format  = css_comment_format;
-    m_Rules[ "CSS_COMMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(ATTRIBUTE_NAME);
-    rule.format  = attribute_name_format;
-    m_Rules[ "ATTRIBUTE_NAME" ] = rule;
-    rule.pattern = QRegularExpression(ATTRIBUTE_VALUE);
-    rule.format  = attribute_value_format;
-    m_Rules[ "ATTRIBUTE_VALUE" ] = rule;
-    rule.pattern = QRegularExpression(ENTITY_BEGIN);
-    rule.format  = entity_format;
-    m_Rules[ "ENTITY_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(ENTITY_END);
-    rule.format  = entity_format;
-    m_Rules[ "ENTITY_END" ] = rule;
-    rule.pattern = QRegularExpression(SPECIAL_SPACE_BEGIN);
-    rule.format  = special_space_format;
-    m_Rules[ "SPECIAL_SPACE_BEGIN" ] = rule;
+    m_Rules[ Rule_DOCTYPE_BEGIN ].pattern = QRegularExpression(DOCTYPE_BEGIN);
+    m_Rules[ Rule_DOCTYPE_BEGIN ].format  = doctype_format;
+    m_Rules[ Rule_HTML_ELEMENT_BEGIN ].pattern = QRegularExpression(HTML_ELEMENT_BEGIN);
+    m_Rules[ Rule_HTML_ELEMENT_BEGIN ].format  = html_format;
+    m_Rules[ Rule_HTML_ELEMENT_END ].pattern = QRegularExpression(HTML_ELEMENT_END);
+    m_Rules[ Rule_HTML_ELEMENT_END ].format  = html_format;
+    m_Rules[ Rule_HTML_COMMENT_BEGIN ].pattern = QRegularExpression(HTML_COMMENT_BEGIN);
+    m_Rules[ Rule_HTML_COMMENT_BEGIN ].format  = html_comment_format;
+    m_Rules[ Rule_HTML_COMMENT_END ].pattern = QRegularExpression(HTML_COMMENT_END);
+    m_Rules[ Rule_HTML_COMMENT_END ].format  = html_comment_format;
+    m_Rules[ Rule_CSS_BEGIN ].pattern = QRegularExpression(CSS_BEGIN);
+    m_Rules[ Rule_CSS_BEGIN ].format  = css_format;
+    m_Rules[ Rule_CSS_END ].pattern = QRegularExpression(CSS_END);
+    m_Rules[ Rule_CSS_END ].format  = css_format;
+    m_Rules[ Rule_CSS_COMMENT_BEGIN ].pattern = QRegularExpression(CSS_COMMENT_BEGIN);
+    m_Rules[ Rule_CSS_COMMENT_BEGIN ].format  = css_comment_format;
+    m_Rules[ Rule_CSS_COMMENT_END ].pattern = QRegularExpression(CSS_COMMENT_END);
+    m_Rules[ Rule_CSS_COMMENT_END ].format  = css_comment_format;
+    m_Rules[ Rule_ATTRIBUTE_NAME ].pattern = QRegularExpression(ATTRIBUTE_NAME);
+    m_Rules[ Rule_ATTRIBUTE_NAME ].format  = attribute_name_format;
+    m_Rules[ Rule_ATTRIBUTE_VALUE ].pattern = QRegularExpression(ATTRIBUTE_VALUE);
+    m_Rules[ Rule_ATTRIBUTE_VALUE ].format  = attribute_value_format;
+    m_Rules[ Rule_ENTITY_BEGIN ].pattern = QRegularExpression(ENTITY_BEGIN);
+    m_Rules[ Rule_ENTITY_BEGIN ].format  = entity_format;
+    m_Rules[ Rule_ENTITY_END ].pattern = QRegularExpression(ENTITY_END);
+    m_Rules[ Rule_ENTITY_END ].format  = entity_format;
+    m_Rules[ Rule_SPECIAL_SPACE_BEGIN ].pattern = QRegularExpression(SPECIAL_SPACE_BEGIN);
+    m_Rules[ Rule_SPECIAL_SPACE_BEGIN ].format  = special_space_format;
+    m_ElementName = QRegularExpression(HTML_ELEMENT_NAME);
+
+    // Compile everything now instead of on first use in highlightBlock
+    for (int i = 0; i < Rule_Count; ++i) {
+        m_Rules[ i ].pattern.optimize();
+    }
+    m_ElementName.optimize();
 }
 
 // Overrides the function from QSyntaxHighlighter;
@@ -163,9 +160,6 @@ void XHTMLHighlighter::highlightBlock(const QString &text)
         return;
     }
 
-    SettingsStore settings;
-    m_enableSpellCheck = settings.spellCheck();
-
     // Run spell check over the text.
     if (m_enableSpellCheck && m_checkSpelling) {
         CheckSpelling(text);
@@ -191,62 +185,58 @@ void XHTMLHighlighter::rehighlight()
 
 
 // Returns the regex that matches the left bracket of a state
-QRegularExpression XHTMLHighlighter::GetLeftBracketRegEx(int state) const
+const QRegularExpression &XHTMLHighlighter::GetLeftBracketRegEx(int state) const
 {
-    QRegularExpression empty;
-
     switch (state) {
         case State_Entity:
-            return m_Rules.value("ENTITY_BEGIN").pattern;
+            return m_Rules[ Rule_ENTITY_BEGIN ].pattern;
 
         case State_HTML:
-            return m_Rules.value("HTML_ELEMENT_BEGIN").pattern;
+            return m_Rules[ Rule_HTML_ELEMENT_BEGIN ].pattern;
 
         case State_HTMLComment:
-            return m_Rules.value("HTML_COMMENT_BEGIN").pattern;
+            return m_Rules[ Rule_HTML_COMMENT_BEGIN ].pattern;
 
         case State_CSS:
-            return m_Rules.value("CSS_BEGIN").pattern;
+            return m_Rules[ Rule_CSS_BEGIN ].pattern;
 
         case State_CSSComment:
-            return m_Rules.value("CSS_COMMENT_BEGIN").pattern;
+            return m_Rules[ Rule_CSS_COMMENT_BEGIN ].pattern;
 
         case State_DOCTYPE:
-            return m_Rules.value("DOCTYPE_BEGIN").pattern;
+            return m_Rules[ Rule_DOCTYPE_BEGIN ].pattern;
 
         case State_SpSpace:
-            return m_Rules.value("SPECIAL_SPACE_BEGIN").pattern;
+            return m_Rules[ Rule_SPECIAL_SPACE_BEGIN ].pattern;
 
         default:
-            return empty;
+            return m_NoBracket;
     }
 }
 
 
 // Returns the regex that matches the right bracket of a state
-QRegularExpression XHTMLHighlighter::GetRightBracketRegEx(int state) const
+const QRegularExpression &XHTMLHighlighter::GetRightBracketRegEx(int state) const
 {
-    QRegularExpression empty;
-
     switch (state) {
         case State_Entity:
-            return m_Rules.value("ENTITY_END").pattern;
+            return m_Rules[ Rule_ENTITY_END ].pattern;
 
         case State_DOCTYPE:
         case State_HTML:
-            return m_Rules.value("HTML_ELEMENT_END").pattern;
+            return m_Rules[ Rule_HTML_ELEMENT_END ].pattern;
 
         case State_HTMLComment:
-            return m_Rules.value("HTML_COMMENT_END").pattern;
+            return m_Rules[ Rule_HTML_COMMENT_END ].pattern;
 
         case State_CSS:
-            return m_Rules.value("CSS_END").pattern;
+            return m_Rules[ Rule_CSS_END ].pattern;
 
         case State_CSSComment:
-            return m_Rules.value("CSS_COMMENT_END").pattern;
+            return m_Rules[ Rule_CSS_COMMENT_END ].pattern;
 
         default:
-            return empty;
+            return m_NoBracket;
     }
 }
 
@@ -293,23 +283,21 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
 {
     if (state == State_HTML) {
         // First paint everything the color of the brackets
-        setFormat(index, length, m_Rules.value("HTML_ELEMENT_BEGIN").format);
-        QRegularExpression name  = m_Rules.value("ATTRIBUTE_NAME").pattern;
-        QRegularExpression value = m_Rules.value("ATTRIBUTE_VALUE").pattern;
+        setFormat(index, length, m_Rules[ Rule_HTML_ELEMENT_BEGIN ].format);
+        const QRegularExpression &name  = m_Rules[ Rule_ATTRIBUTE_NAME ].pattern;
+        const QRegularExpression &value = m_Rules[ Rule_ATTRIBUTE_VALUE ].pattern;
         // Used to move over the line
         int main_index = index;
 
         // We skip over the left bracket (if it's present)
-        QRegularExpression bracket(HTML_ELEMENT_BEGIN);
-        QRegularExpressionMatch bracket_match = bracket.match(text, main_index);
+        QRegularExpressionMatch bracket_match = m_Rules[ Rule_HTML_ELEMENT_BEGIN ].pattern.match(text, main_index);
         if (bracket_match.hasMatch() && bracket_match.capturedStart() == main_index) {
             main_index += bracket_match.capturedLength();
         }
 
         // We skip over the element name (if it's present)
         // because we want it to be the same color as the brackets
-        QRegularExpression elem_name(HTML_ELEMENT_NAME);
-        QRegularExpressionMatch elem_name_match = elem_name.match(text, main_index);
+        QRegularExpressionMatch elem_name_match = m_ElementName.match(text, main_index);
         if (elem_name_match.hasMatch() && elem_name_match.capturedStart() == main_index) {
             main_index += elem_name_match.capturedLength();
         }
@@ -337,8 +325,8 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
             if (((name_index  != -1) && (name_index  < index + length)) ||
                 ((value_index != -1) && (value_index < index + length))) {
                 // ... otherwise format the found sections
-                setFormat(name_index,  name_len,  m_Rules.value("ATTRIBUTE_NAME").format);
-                setFormat(value_index, value_len, m_Rules.value("ATTRIBUTE_VALUE").format);
+                setFormat(name_index,  name_len,  m_Rules[ Rule_ATTRIBUTE_NAME ].format);
+                setFormat(value_index, value_len, m_Rules[ Rule_ATTRIBUTE_VALUE ].format);
             } else {
                 break;
             }
@@ -351,17 +339,17 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
             }
         }
     } else if (state == State_HTMLComment) {
-        setFormat(index, length, m_Rules.value("HTML_COMMENT_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_HTML_COMMENT_BEGIN ].format);
     } else if (state == State_CSS) {
-        setFormat(index, length, m_Rules.value("CSS_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_CSS_BEGIN ].format);
     } else if (state == State_CSSComment) {
-        setFormat(index, length, m_Rules.value("CSS_COMMENT_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_CSS_COMMENT_BEGIN ].format);
     } else if (state == State_Entity) {
-        setFormat(index, length, m_Rules.value("ENTITY_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_ENTITY_BEGIN ].format);
     } else if (state == State_SpSpace) {
-        setFormat(index, length, m_Rules.value("SPECIAL_SPACE_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_SPECIAL_SPACE_BEGIN ].format);
     } else if (state == State_DOCTYPE) {
-        setFormat(index, length, m_Rules.value("DOCTYPE_BEGIN").format);
+        setFormat(index, length, m_Rules[ Rule_DOCTYPE_BEGIN ].format);
     }
 }
 
@@ -371,8 +359,8 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
 // if it is, the node is formatted
 void XHTMLHighlighter::HighlightLine(const QString &text, int state)
 {
-    QRegularExpression left_bracket_regex  = GetLeftBracketRegEx(state);
-    QRegularExpression right_bracket_regex = GetRightBracketRegEx(state);
+    const QRegularExpression &left_bracket_regex  = GetLeftBracketRegEx(state);
+    const QRegularExpression &right_bracket_regex = GetRightBracketRegEx(state);
     int main_index = 0;
 
     // We loop over the line several times
@@ -32,6 +32,7 @@ class QTextDocument;
 
 class XHTMLHighlighter : public QSyntaxHighlighter
 {
+    Q_OBJECT
 
 public:
 
@@ -41,6 +42,10 @@ public:
     void SetRules();
     void rehighlight();
 
+    // Picks up a change to the automatic spell check setting
+    // without rehighlighting the document
+    void RefreshSpellCheckSetting();
+
 protected:
 
     // Overrides the function from QSyntaxHighlighter;
@@ -51,10 +56,10 @@ protected:
 private:
 
     // Returns the regex that matches the left bracket of a state
-    QRegularExpression GetLeftBracketRegEx(int state) const;
+    const QRegularExpression &GetLeftBracketRegEx(int state) const;
 
     // Returns the regex that matches the right bracket of a state
-    QRegularExpression GetRightBracketRegEx(int state) const;
+    const QRegularExpression &GetRightBracketRegEx(int state) const;
 
     // Sets the requested state for the current text block
     void SetState(int state);
@@ -97,19 +102,47 @@ private:
         State_DOCTYPE       = 1 << 7
     };
 
+    // All of our highlighting rules
+    enum RuleType {
+        Rule_DOCTYPE_BEGIN,
+        Rule_HTML_ELEMENT_BEGIN,
+        Rule_HTML_ELEMENT_END,
+        Rule_HTML_COMMENT_BEGIN,
+        Rule_HTML_COMMENT_END,
+        Rule_CSS_BEGIN,
+        Rule_CSS_END,
+        Rule_CSS_COMMENT_BEGIN,
+        Rule_CSS_COMMENT_END,
+        Rule_ATTRIBUTE_NAME,
+        Rule_ATTRIBUTE_VALUE,
+        Rule_ENTITY_BEGIN,
+        Rule_ENTITY_END,
+        Rule_SPECIAL_SPACE_BEGIN,
+        Rule_Count
+    };
+
     struct HighlightingRule {
         QRegularExpression pattern;
         QTextCharFormat format;
     };
 
     // Stores all of our highlighting rules
-    // and the text formats used
-    QHash<QString, HighlightingRule> m_Rules;
+    // and the text formats used, indexed by RuleType.
+    // The patterns are compiled once in SetRules.
+    HighlightingRule m_Rules[Rule_Count];
+
+    // Matches the element name after the left bracket of a tag
+    QRegularExpression m_ElementName;
+
+    // Returned for states that have no bracket
+    QRegularExpression m_NoBracket;
 
     // Determine if spell check should be used on the document.
     bool m_checkSpelling;
 
-    // Determine if automatic spell check is enabled
+    // Determine if automatic spell check is enabled.
+    // Cached from the settings by SetRules and RefreshSpellCheckSetting
+    // so highlightBlock does not read them for every block.
     bool m_enableSpellCheck;
 
     SettingsStore::CodeViewAppearance m_codeViewAppearance;
@@ -0,0 +1,158 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#ifdef _WIN32
+#define NOMINMAX
+#endif
+
+#include "unzip.h"
+#ifdef _WIN32
+#include "iowin32.h"
+#endif
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+#include "Misc/Utility.h"
+#include "Misc/ZipEntryCache.h"
+
+#ifndef MAX_PATH
+#define MAX_PATH 2048
+#endif
+
+// the compression methods we can copy into a new archive as they are
+static const int STORED_METHOD = 0;
+static const int DEFLATED_METHOD = 8;
+
+// general purpose flag bits
+static const unsigned long ENCRYPTED_FLAG = 1;
+static const unsigned long UTF8_NAME_FLAG = 1 << 11;
+
+
+static qint64 LastModified(const QFileInfo &fi)
+{
+    const QDateTime lastModifiedDate = fi.lastModified();
+    return lastModifiedDate.isValid() ? lastModifiedDate.toMSecsSinceEpoch() : 0;
+}
+
+
+ZipEntryCache::ZipEntryCache()
+    : m_ArchiveSize(0),
+      m_ArchiveModified(0)
+{
+}
+
+
+void ZipEntryCache::Record(const QString &archive_path)
+{
+    Clear();
+#ifdef Q_OS_WIN32
+    zlib_filefunc64_def ffunc;
+    fill_win32_filefunc64W(&ffunc);
+    unzFile zfile = unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(archive_path)).c_str(), &ffunc);
+#else
+    unzFile zfile = unzOpen64(QDir::toNativeSeparators(archive_path).toUtf8().constData());
+#endif
+
+    if (zfile == NULL) {
+        return;
+    }
+
+    QHash<QString, Entry> entries;
+    int res = unzGoToFirstFile(zfile);
+
+    while (res == UNZ_OK) {
+        char file_name[MAX_PATH] = {0};
+        unz_file_info64 file_info;
+        unz64_file_pos file_pos;
+
+        if ((unzGetCurrentFileInfo64(zfile, &file_info, file_name, MAX_PATH, NULL, 0, NULL, 0) == UNZ_OK) &&
+            (unzGetFilePos64(zfile, &file_pos) == UNZ_OK)) {
+            QString bookpath = QString::fromUtf8(file_name);
+            bool copyable = ((file_info.compression_method == STORED_METHOD) ||
+                             (file_info.compression_method == DEFLATED_METHOD)) &&
+                            !(file_info.flag & ENCRYPTED_FLAG);
+
+            // only plain ascii names are safe to match when the name is not flagged as utf-8
+            bool name_ok = (file_info.flag & UTF8_NAME_FLAG) || (bookpath.toLatin1() == QByteArray(file_name));
+
+            if (copyable && name_ok && !bookpath.isEmpty() && !bookpath.endsWith('/')) {
+                Entry entry;
+                entry.pos_in_zip_directory = file_pos.pos_in_zip_directory;
+                entry.num_of_file = file_pos.num_of_file;
+                entry.crc = (quint32) file_info.crc;
+                entry.compressed_size = (qint64) file_info.compressed_size;
+                entry.uncompressed_size = (qint64) file_info.uncompressed_size;
+                entries.insert(bookpath, entry);
+            }
+        }
+        res = unzGoToNextFile(zfile);
+    }
+
+    unzClose(zfile);
+
+    if (res != UNZ_END_OF_LIST_OF_FILE) {
+        return;
+    }
+
+    QFileInfo fi(archive_path);
+    m_ArchivePath = fi.absoluteFilePath();
+    m_ArchiveSize = fi.size();
+    m_ArchiveModified = LastModified(fi);
+    m_Entries = entries;
+}
+
+
+void ZipEntryCache::Clear()
+{
+    m_ArchivePath.clear();
+    m_ArchiveSize = 0;
+    m_ArchiveModified = 0;
+    m_Entries.clear();
+}
+
+
+QString ZipEntryCache::GetArchivePath() const
+{
+    if (m_ArchivePath.isEmpty()) {
+        return QString();
+    }
+
+    // someone else may have replaced or changed the archive since
+    QFileInfo fi(m_ArchivePath);
+    if (!fi.exists() || (fi.size() != m_ArchiveSize) || (LastModified(fi) != m_ArchiveModified)) {
+        return QString();
+    }
+    return m_ArchivePath;
+}
+
+
+bool ZipEntryCache::Find(const QString &bookpath, Entry &entry) const
+{
+    QHash<QString, Entry>::const_iterator it = m_Entries.constFind(bookpath);
+    if (it == m_Entries.constEnd()) {
+        return false;
+    }
+    entry = it.value();
+    return true;
+}
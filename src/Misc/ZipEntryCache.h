@@ -0,0 +1,87 @@
+/************************************************************************
+**
+**  Copyright (C) 2020 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef ZIPENTRYCACHE_H
+#define ZIPENTRYCACHE_H
+
+#include <QHash>
+#include <QString>
+
+/**
+ * Remembers where every entry of the epub a book was last read from
+ * or saved to sits in that archive, still compressed, together with
+ * its CRC and sizes.
+ *
+ * When the book is saved as an epub again, any file whose content
+ * still has the same size and CRC can be copied over raw instead of
+ * being deflated again, which makes re-saving image heavy books
+ * mostly a matter of I/O.
+ */
+class ZipEntryCache
+{
+
+public:
+    struct Entry {
+        // minizip's unz64_file_pos for the entry
+        quint64 pos_in_zip_directory;
+        quint64 num_of_file;
+
+        quint32 crc;
+        qint64 compressed_size;
+        qint64 uncompressed_size;
+    };
+
+    ZipEntryCache();
+
+    /**
+     * Reads the central directory of the archive and remembers its
+     * stored and deflated entries. Nothing is decompressed.
+     * Any previously recorded archive is forgotten.
+     *
+     * @param archive_path The full path to the epub.
+     */
+    void Record(const QString &archive_path);
+
+    void Clear();
+
+    /**
+     * The archive recorded, if it is still there exactly
+     * as it was recorded. Empty otherwise.
+     */
+    QString GetArchivePath() const;
+
+    /**
+     * Looks up the entry stored under the book path.
+     *
+     * @return true if there is one.
+     */
+    bool Find(const QString &bookpath, Entry &entry) const;
+
+private:
+    QString m_ArchivePath;
+    qint64 m_ArchiveSize;
+    qint64 m_ArchiveModified;
+    QHash<QString, Entry> m_Entries;
+};
+
+#endif // ZIPENTRYCACHE_H
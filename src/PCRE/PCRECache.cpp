@@ -26,6 +26,9 @@ PCRECache *PCRECache::m_instance = 0;
 
 PCRECache *PCRECache::instance()
 {
+    static QMutex instance_mutex;
+    QMutexLocker locker(&instance_mutex);
+
     if (m_instance == 0) {
         m_instance = new PCRECache();
     }
@@ -40,20 +43,24 @@ PCRECache::PCRECache()
 
 bool PCRECache::insert(const QString &key, SPCRE *object)
 {
+    QMutexLocker locker(&m_mutex);
     // raise cost of each entry to 5 to reduce memory footprint
-    return m_cache.insert(key, object, 5);
+    return m_cache.insert(key, new QSharedPointer<SPCRE>(object), 5);
 }
 
-SPCRE *PCRECache::getObject(const QString &key)
+QSharedPointer<SPCRE> PCRECache::getObject(const QString &key)
 {
-    // Create a new SPCRE if it doesn't already exist.
-    // The key is the pattern for initializing the SPCRE.
-    if (!m_cache.contains(key)) {
-        SPCRE *spcre = new SPCRE(key);
-        // raise cost of each entry to 5 to reduce memory footprint
-        m_cache.insert(key, spcre, 5);
-        return spcre;
+    QMutexLocker locker(&m_mutex);
+    QSharedPointer<SPCRE> *cached = m_cache.object(key);
+
+    if (cached) {
+        return *cached;
     }
 
-    return m_cache.object(key);
+    // Create a new SPCRE if it doesn't already exist.
+    // The key is the pattern for initializing the SPCRE.
+    QSharedPointer<SPCRE> spcre(new SPCRE(key));
+    // raise cost of each entry to 5 to reduce memory footprint
+    m_cache.insert(key, new QSharedPointer<SPCRE>(spcre), 5);
+    return spcre;
 }
@@ -26,6 +26,8 @@
 #define PCRECACHE_H
 
 #include <QtCore/QCache>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QString>
 
 #include "PCRE/SPCRE.h"
@@ -34,6 +36,9 @@
  * Singleton. A cache of SPCRE regular expression objects.
  *
  * The SPCRE's are cached to improve performance.
+ * The cache is safe to use from any thread. The SPCRE's are
+ * reference counted so one stays valid for as long as it is
+ * held, even after it has been evicted from the cache.
  */
 class PCRECache
 {
@@ -49,7 +54,7 @@ public:
      * pattern by the SPCRE as a string.
      *
      * @param key The key associated with the SPCRE.
-     * @param object The SPCRE to store.
+     * @param object The SPCRE to store. The cache takes ownership of it.
      *
      * @return True if the object was successfully inserted.
      */
@@ -62,7 +67,7 @@ public:
      *
      * @param key The key associated with the SPCRE.
      */
-    SPCRE *getObject(const QString &key);
+    QSharedPointer<SPCRE> getObject(const QString &key);
 
 private:
     /**
@@ -71,7 +76,9 @@ private:
     PCRECache();
 
     // The cache that we store the SPCRE's.
-    QCache<QString, SPCRE> m_cache;
+    QCache<QString, QSharedPointer<SPCRE> > m_cache;
+    // Guards the cache.
+    QMutex m_mutex;
     // The single instance of the cache.
     static PCRECache *m_instance;
 };
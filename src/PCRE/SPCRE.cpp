@@ -19,6 +19,8 @@
 **
 *************************************************************************/
 
+#include <QtCore/QThreadStorage>
+
 #include "PCRE/SPCRE.h"
 #include "PCRE/PCREReplaceTextBuilder.h"
 #include "sigil_constants.h"
@@ -26,12 +28,67 @@
 // The maximum number of catpures that we will allow.
 const int PCRE_MAX_CAPTURE_GROUPS = 30;
 
+// The sizes of the JIT stack each thread uses for matching.
+const int PCRE_JIT_STACK_START_SIZE = 32 * 1024;
+const int PCRE_JIT_STACK_MAX_SIZE = 1024 * 1024;
+
+// Constructs that let a match depend on text it does not consume, or that
+// commit to the longest run they can find. A cut in the text after the end
+// of a match can change which match these find, so they always rescan.
+static const char *CUT_SENSITIVE_CONSTRUCTS[] = {
+    "(?=", "(?!", "(?<=", "(?<!", "(?>", "(?(", "(*",
+    "^", "$", "\\b", "\\B", "\\A", "\\z", "\\Z", "\\G", "\\R", "\\X",
+    "*+", "++", "?+", "}+"
+};
+
+static bool CanResumeLastMatchScan(const QString &pattern)
+{
+    for (unsigned int i = 0; i < sizeof(CUT_SENSITIVE_CONSTRUCTS) / sizeof(CUT_SENSITIVE_CONSTRUCTS[0]); ++i) {
+        if (pattern.contains(QLatin1String(CUT_SENSITIVE_CONSTRUCTS[i]))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Owns the JIT stack of one thread and frees it when the thread finishes.
+class JITStack
+{
+public:
+    JITStack() : m_stack(pcre16_jit_stack_alloc(PCRE_JIT_STACK_START_SIZE, PCRE_JIT_STACK_MAX_SIZE)) {}
+    ~JITStack() {
+        if (m_stack != NULL) {
+            pcre16_jit_stack_free(m_stack);
+        }
+    }
+    pcre16_jit_stack *stack() {
+        return m_stack;
+    }
+private:
+    pcre16_jit_stack *m_stack;
+};
+
+// A JIT stack can only be used by one thread at a time so
+// each thread matching a compiled pattern gets its own.
+static pcre16_jit_stack *GetThreadJITStack(void *)
+{
+    static QThreadStorage<JITStack *> jit_stacks;
+
+    if (!jit_stacks.hasLocalData()) {
+        jit_stacks.setLocalData(new JITStack());
+    }
+
+    return jit_stacks.localData()->stack();
+}
+
 SPCRE::SPCRE(const QString &patten)
 {
     m_pattern = patten;
     m_re = NULL;
     m_study = NULL;
     m_captureSubpatternCount = 0;
+    m_canResumeScan = CanResumeLastMatchScan(m_pattern);
     const char *error;
     int erroroffset;
     m_re = pcre16_compile(m_pattern.utf16(), PCRE_UTF16 | PCRE_MULTILINE, &error, &erroroffset, NULL);
@@ -40,7 +97,14 @@ SPCRE::SPCRE(const QString &patten)
     if (m_re != NULL) {
         m_valid = true;
         // Study the pattern and save the results of the study.
-        m_study = pcre16_study(m_re, 0, &error);
+        // If PCRE was built without JIT support the pattern is simply
+        // studied and matched by the interpreter.
+        m_study = pcre16_study(m_re, PCRE_STUDY_JIT_COMPILE, &error);
+
+        if (m_study != NULL) {
+            pcre16_assign_jit_stack(m_study, GetThreadJITStack, NULL);
+        }
+
         // Store the number of capture subpatterns.
         pcre16_fullinfo(m_re, m_study, PCRE_INFO_CAPTURECOUNT, &m_captureSubpatternCount);
     }
@@ -58,7 +122,8 @@ SPCRE::~SPCRE()
     }
 
     if (m_study != NULL) {
-        pcre16_free(m_study);
+        // Also frees any JIT compiled code.
+        pcre16_free_study(m_study);
         m_study = NULL;
     }
 }
@@ -105,13 +170,22 @@ int SPCRE::getCaptureStringNumber(const QString &name)
 
 QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
 {
+    return getEveryMatchInfo(text, 0, text.length());
+}
+
+QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text, int subject_start, int subject_end)
+{
+    // Keep the subject within the text.
+    subject_start = qMax(subject_start, 0);
+    subject_end = qMin(subject_end, text.length());
+
     // This function is very similar to getNextMatchInfo but we don't
     // want to put a call to getNextMatchInfo in a loop because it allocates
     // a new ovector. We want to avoid this and only do one allocation so we
     // reuse the logic and put the call to generateMatchInfo in the loop.
     QList<SPCRE::MatchInfo> info;
 
-    if (m_re == NULL || text.isEmpty()) {
+    if (m_re == NULL || subject_end <= subject_start) {
         return info;
     }
 
@@ -150,7 +224,7 @@ QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
             info.append(generateMatchInfo(ovector, ovector_count));
         }
 
-        rc = pcre16_exec(m_re, m_study, text.utf16(), text.length(), last_offset[1], 0, ovector, ovector_size);
+        rc = pcre16_exec(m_re, m_study, text.utf16() + subject_start, subject_end - subject_start, last_offset[1], 0, ovector, ovector_size);
     } while (rc >= 0 && ovector[0] != ovector[1] && ovector[1] != last_offset[1] && ovector[0] < ovector[1]);
 
     delete[] ovector;
@@ -159,9 +233,18 @@ QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
 
 SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
 {
+    return getFirstMatchInfo(text, 0, text.length());
+}
+
+SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text, int subject_start, int subject_end)
+{
+    // Keep the subject within the text.
+    subject_start = qMax(subject_start, 0);
+    subject_end = qMin(subject_end, text.length());
+
     SPCRE::MatchInfo match_info;
 
-    if (m_re == NULL || text.isEmpty()) {
+    if (m_re == NULL || subject_end <= subject_start) {
         return match_info;
     }
 
@@ -183,7 +266,7 @@ SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
     // MSVC doesn't support it.
     int *ovector = new int[ovector_size];
     memset(ovector, 0, sizeof(int)*ovector_size);
-    rc = pcre16_exec(m_re, m_study, text.utf16(), text.length(), 0, 0, ovector, ovector_size);
+    rc = pcre16_exec(m_re, m_study, text.utf16() + subject_start, subject_end - subject_start, 0, 0, ovector, ovector_size);
 
     if (rc >= 0 && ovector[0] != ovector[1]) {
         match_info = generateMatchInfo(ovector, ovector_count);
@@ -195,14 +278,56 @@ SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
 
 SPCRE::MatchInfo SPCRE::getLastMatchInfo(const QString &text)
 {
-    QList<SPCRE::MatchInfo> info;
-    info = getEveryMatchInfo(text);
+    return getLastMatchInfo(text, 0, text.length(), 0);
+}
+
+SPCRE::MatchInfo SPCRE::getLastMatchInfo(const QString &text, int subject_start, int subject_end, int scan_from)
+{
+    // Keep the subject within the text.
+    subject_start = qMax(subject_start, 0);
+    subject_end = qMin(subject_end, text.length());
 
-    if (!info.isEmpty()) {
-        return info.last();
-    } else {
-        return SPCRE::MatchInfo();
+    SPCRE::MatchInfo match_info;
+
+    if (m_re == NULL || subject_end <= subject_start || scan_from < subject_start || scan_from > subject_end) {
+        return match_info;
+    }
+
+    if (!m_canResumeScan) {
+        scan_from = subject_start;
+    }
+
+    int rc = 0;
+    // Set the size of the array based on the number of capture subpatterns
+    // if it does not exceed our maximum size.
+    int ovector_count = getCaptureSubpatternCount();
+
+    if (ovector_count > PCRE_MAX_CAPTURE_GROUPS) {
+        ovector_count = PCRE_MAX_CAPTURE_GROUPS;
     }
+
+    // The vector needs to be a multiple of 3 and have at least one location
+    // for the full matched string.
+    int ovector_size = (1 + ovector_count) * 3;
+    int *ovector = new int[ovector_size];
+    memset(ovector, 0, sizeof(int)*ovector_size);
+    int last_end = scan_from - subject_start;
+
+    // Like getEveryMatchInfo we stop at the first empty match but we only
+    // keep the latest match instead of collecting all of them.
+    while (true) {
+        rc = pcre16_exec(m_re, m_study, text.utf16() + subject_start, subject_end - subject_start, last_end, 0, ovector, ovector_size);
+
+        if (rc < 0 || ovector[0] >= ovector[1] || ovector[1] == last_end) {
+            break;
+        }
+
+        match_info = generateMatchInfo(ovector, ovector_count);
+        last_end = ovector[1];
+    }
+
+    delete[] ovector;
+    return match_info;
 }
 
 bool SPCRE::replaceText(const QString &text, const QList<std::pair<int, int>> &capture_groups_offsets, const QString &replacement_pattern, QString &out)
@@ -211,6 +336,32 @@ bool SPCRE::replaceText(const QString &text, const QList<std::pair<int, int>> &c
     return builder.BuildReplacementText(*this, text, capture_groups_offsets, replacement_pattern, out);
 }
 
+int SPCRE::replaceEveryMatch(const QString &text, const QList<MatchInfo> &match_info, const QString &replacement_pattern, QString &out)
+{
+    PCREReplaceTextBuilder builder;
+    int count = 0;
+    // The end of the text we have copied to out so far.
+    int copied_to = 0;
+    out.clear();
+    out.reserve(text.length());
+
+    for (int i = 0; i < match_info.count(); ++i) {
+        int match_start = match_info.at(i).offset.first;
+        int match_end = match_info.at(i).offset.second;
+        QString replaced_text;
+
+        if (builder.BuildReplacementText(*this, text.mid(match_start, match_end - match_start), match_info.at(i).capture_groups_offsets, replacement_pattern, replaced_text)) {
+            out.append(text.midRef(copied_to, match_start - copied_to));
+            out.append(replaced_text);
+            copied_to = match_end;
+            count++;
+        }
+    }
+
+    out.append(text.midRef(copied_to));
+    return count;
+}
+
 SPCRE::MatchInfo SPCRE::generateMatchInfo(int ovector[], int ovector_count)
 {
     MatchInfo match_info;
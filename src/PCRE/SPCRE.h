@@ -123,9 +123,46 @@ public:
      * @return A list of MatchInfo objects.
      */
     QList<MatchInfo> getEveryMatchInfo(const QString &text);
+
+    /**
+     * Same as getEveryMatchInfo but only text[subject_start, subject_end)
+     * is matched against, without copying it out of text.
+     *
+     * @return A list of MatchInfo objects with offsets relative to subject_start.
+     */
+    QList<MatchInfo> getEveryMatchInfo(const QString &text, int subject_start, int subject_end);
+
     MatchInfo getFirstMatchInfo(const QString &text);
+
+    /**
+     * Same as getFirstMatchInfo but only text[subject_start, subject_end)
+     * is matched against, without copying it out of text.
+     *
+     * @return The first match with offsets relative to subject_start.
+     */
+    MatchInfo getFirstMatchInfo(const QString &text, int subject_start, int subject_end);
     MatchInfo getLastMatchInfo(const QString &text);
 
+    /**
+     * Returns the last match of a forward scan over part of a text.
+     *
+     * Only text[subject_start, subject_end) is matched against, exactly as
+     * if it had been cut out of text, but no copy is made and the scan can
+     * resume from an offset known to be the end of an earlier match.
+     * Patterns using lookaround, anchors, word boundaries, atomic groups or
+     * possessive quantifiers can find different earlier matches once the
+     * text is cut, so for them scan_from is ignored and the whole subject
+     * is scanned.
+     *
+     * @param text The text containing the subject.
+     * @param subject_start Where the subject starts in text.
+     * @param subject_end Where the subject ends in text.
+     * @param scan_from Where in text to start scanning for matches.
+     *
+     * @return The last match with offsets relative to subject_start.
+     */
+    MatchInfo getLastMatchInfo(const QString &text, int subject_start, int subject_end, int scan_from);
+
     /**
      * Replaces the given text using a replacement pattern. The matched text is
      * required because the replacement pattern can references the capture
@@ -142,6 +179,22 @@ public:
      */
     bool replaceText(const QString &text, const QList<std::pair<int, int>> &capture_groups_offsets, const QString &replacement_pattern, QString &out);
 
+    /**
+     * Replaces a list of matches within a text.
+     *
+     * The new text is built in a single forward pass so the cost is linear
+     * in the length of the text no matter how many matches there are.
+     *
+     * @param text The text the matches were found in.
+     * @param match_info The matches to replace, in the order they occur in text.
+     * @param replacement_pattern The pattern / text to use to create the
+     * replacement text for each match.
+     * @param[out] out The text with the matches replaced. Must not be text.
+     *
+     * @return The number of matches replaced.
+     */
+    int replaceEveryMatch(const QString &text, const QList<MatchInfo> &match_info, const QString &replacement_pattern, QString &out);
+
 private:
     MatchInfo generateMatchInfo(int ovector[], int ovector_count);
 
@@ -155,6 +208,8 @@ private:
     pcre16_extra *m_study;
     // The number of capture subpatterns with the expression.
     int m_captureSubpatternCount;
+    // Whether a last match scan may start after an earlier match.
+    bool m_canResumeScan;
 };
 
 #endif // SPCRE_H
@@ -50,7 +50,8 @@ static const QString W3C_HTML_FORM = "<html>"
 
 CSSResource::CSSResource(const QString &mainfolder, const QString &fullfilepath, QObject *parent)
     : TextResource(mainfolder, fullfilepath, parent),
-      m_TemporaryValidationFiles(QList<QString>())
+      m_TemporaryValidationFiles(QList<QString>()),
+      m_CSSInfoRevision(-1)
 {
 }
 
@@ -77,6 +78,17 @@ bool CSSResource::DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors)
     return false;
 }
 
+QSharedPointer<const CSSInfo> CSSResource::GetCSSInfo()
+{
+    QMutexLocker locker(&m_CSSInfoMutex);
+    int revision = GetTextRevision();
+    if (!m_CSSInfo || (revision != m_CSSInfoRevision)) {
+        m_CSSInfo = QSharedPointer<const CSSInfo>(new CSSInfo(GetText(), true));
+        m_CSSInfoRevision = revision;
+    }
+    return m_CSSInfo;
+}
+
 Resource::ResourceType CSSResource::Type() const
 {
     return Resource::CSSResourceType;
@@ -26,6 +26,9 @@
 #ifndef CSSRESOURCE_H
 #define CSSRESOURCE_H
 
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+
 #include "Misc/CSSInfo.h"
 #include "ResourceObjects/TextResource.h"
 
@@ -51,6 +54,15 @@ public:
 
     bool DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors);
 
+    /**
+     * Returns the parsed selectors of the current stylesheet text.
+     * The parse is kept until the text revision changes. The returned
+     * object is shared, so callers must only use its const interface.
+     *
+     * @return The parsed stylesheet.
+     */
+    QSharedPointer<const CSSInfo> GetCSSInfo();
+
     // inherited
     virtual ResourceType Type() const;
 
@@ -59,6 +71,10 @@ public:
 private:
 
     QList<QString> m_TemporaryValidationFiles;
+
+    QSharedPointer<const CSSInfo> m_CSSInfo;
+    int m_CSSInfoRevision;
+    QMutex m_CSSInfoMutex;
 };
 
 #endif // CSSRESOURCE_H
@@ -45,7 +45,10 @@ HTMLResource::HTMLResource(const QString &mainfolder, const QString &fullfilepat
     :
     XMLResource(mainfolder, fullfilepath, parent),
     m_Resources(resources),
-    m_TOCCache("")
+    m_TOCCache(""),
+    m_FactsRevision(-1),
+    m_LinkElementsRevision(-1),
+    m_WellFormedRevision(-1)
 {
 }
 
@@ -95,14 +98,19 @@ void HTMLResource::SetTOCCache(const QString & text)
 
 void HTMLResource::SaveToDisk(bool book_wide_save)
 {
-    SetText(GetText());
+    if (book_wide_save && IsSavedToDisk()) {
+        return;
+    }
+    // Setting the text again would not change it, only its revision and
+    // with it every cache keyed on it, so just refresh the linked resources
+    TrackNewResources(GetPathsToLinkedResources());
     XMLResource::SaveToDisk(book_wide_save);
 }
 
 
 QStringList HTMLResource::GetLinkedStylesheets()
 {
-    QStringList hreflist = XhtmlDoc::GetLinkedStylesheets(GetText());
+    QStringList hreflist = GetDocumentFacts().linked_stylesheets;
     QString startdir = GetFolder();
     QStringList stylesheet_bookpaths;
     foreach(QString ahref, hreflist) {
@@ -119,7 +127,7 @@ QStringList HTMLResource::GetManifestProperties() const
 {
     QStringList properties;
     QReadLocker locker(&GetLock());
-    GumboInterface gi = GumboInterface(GetText(), GetEpubVersion());
+    GumboInterface gi = GumboInterface(GetUtf8Text(), GetEpubVersion());
     gi.parse();
     QStringList props = gi.get_all_properties();
     props.removeDuplicates();
@@ -134,6 +142,76 @@ QStringList HTMLResource::GetManifestProperties() const
 }
 
 
+XhtmlDoc::DocumentFacts HTMLResource::GetDocumentFacts()
+{
+    QMutexLocker locker(&m_FactsMutex);
+    UpdateDocumentFacts();
+    return m_Facts;
+}
+
+
+QList<Headings::Heading> HTMLResource::GetHeadings()
+{
+    QMutexLocker locker(&m_FactsMutex);
+    UpdateDocumentFacts();
+    return m_Headings;
+}
+
+
+QList<XhtmlDoc::XMLElement> HTMLResource::GetLinkElements()
+{
+    QMutexLocker locker(&m_FactsMutex);
+    // read the revision before the text so a concurrent change
+    // can only ever leave us with a cache that is rebuilt next time
+    int revision = GetTextRevision();
+    if (revision != m_LinkElementsRevision) {
+        m_LinkElements = XhtmlDoc::GetTagsInDocument(GetText(), "a");
+        m_LinkElementsRevision = revision;
+    }
+    return m_LinkElements;
+}
+
+
+XhtmlDoc::WellFormedError HTMLResource::WellFormedError()
+{
+    QMutexLocker locker(&m_WellFormedMutex);
+    int revision = GetTextRevision();
+    if (revision != m_WellFormedRevision) {
+        m_WellFormedError = XhtmlDoc::WellFormedErrorForSource(GetText(), GetEpubVersion());
+        m_WellFormedRevision = revision;
+    }
+    return m_WellFormedError;
+}
+
+
+bool HTMLResource::IsWellFormed()
+{
+    return WellFormedError().line == -1;
+}
+
+
+void HTMLResource::UpdateDocumentFacts()
+{
+    int revision = GetTextRevision();
+    if (revision == m_FactsRevision) {
+        return;
+    }
+    QByteArray source = GetUtf8Text();
+    XhtmlDoc::DocumentFacts facts;
+    QList<Headings::Heading> headings;
+    if (!source.isEmpty()) {
+        GumboInterface gi = GumboInterface(source, "any_version");
+        gi.parse();
+        XhtmlDoc::CollectDocumentFacts(gi, facts);
+        headings = Headings::GetHeadingsInDocument(gi, this);
+    }
+    facts.linked_stylesheets = XhtmlDoc::GetLinkedStylesheets(GetText());
+    m_Facts = facts;
+    m_Headings = headings;
+    m_FactsRevision = revision;
+}
+
+
 QStringList HTMLResource::SplitOnSGFSectionMarkers()
 {
     QStringList sections = XhtmlDoc::GetSGFSectionSplits(GetText());
@@ -149,7 +227,7 @@ QStringList HTMLResource::GetPathsToLinkedResources()
     // Can NOT grab Read Lock here as this is also invoked in SetText which has write lock!
     // leading to instant lockup when renaming any resource
     // QReadLocker locker(&GetLock());
-    GumboInterface gi = GumboInterface(GetText(),GetEpubVersion());
+    GumboInterface gi = GumboInterface(GetUtf8Text(),GetEpubVersion());
     gi.parse();
     QList<GumboTag> tags;
     tags << GUMBO_TAG_IMG << GUMBO_TAG_LINK << GUMBO_TAG_AUDIO << GUMBO_TAG_VIDEO;
@@ -159,8 +237,8 @@ QStringList HTMLResource::GetPathsToLinkedResources()
 
         // We skip the link elements that are not stylesheets
         if (node->v.element.tag == GUMBO_TAG_LINK) {
-            GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "rel");
-            if (attr && (QString::fromUtf8(attr->value) != "stylesheet")) { 
+            QByteArray rel = GumboInterface::get_attribute_view(node, "rel");
+            if (!rel.isNull() && (rel != "stylesheet")) { 
                 continue;
             }
         }
@@ -25,7 +25,9 @@
 #define HTMLRESOURCE_H
 
 #include <QtCore/QHash>
+#include <QtCore/QMutex>
 
+#include "BookManipulation/Headings.h"
 #include "Misc/CSSInfo.h"
 #include "ResourceObjects/XMLResource.h"
 
@@ -97,6 +99,45 @@ public:
 
     QStringList GetManifestProperties() const;
 
+    /**
+     * Returns the ids, hrefs, classes, media paths and linked
+     * stylesheets of the current text. They are gathered with one
+     * parse and cached until the text revision changes.
+     *
+     * @return The document facts for the current text.
+     */
+    XhtmlDoc::DocumentFacts GetDocumentFacts();
+
+    /**
+     * Returns all headings of the current text, including those
+     * marked as not wanted in the TOC. Cached like GetDocumentFacts().
+     *
+     * @return The flat list of headings.
+     */
+    QList<Headings::Heading> GetHeadings();
+
+    /**
+     * Returns all anchor elements of the current text, cached
+     * until the text revision changes.
+     *
+     * @return The anchor elements.
+     */
+    QList<XhtmlDoc::XMLElement> GetLinkElements();
+
+    /**
+     * Returns the well-formedness verdict for the current text.
+     * The check is only run again once the text revision changes,
+     * and is safe to call from QtConcurrent workers.
+     *
+     * @return The first error found, line -1 if the text is well formed.
+     */
+    XhtmlDoc::WellFormedError WellFormedError();
+
+    /**
+     * Convenience wrapper around WellFormedError().
+     */
+    bool IsWellFormed();
+
     bool DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors);
 
 signals:
@@ -112,6 +153,12 @@ private:
      */
     void TrackNewResources(const QStringList &filepaths);
 
+    /**
+     * Rebuilds the document facts cache if the text has changed
+     * since it was last filled. Must be called with m_FactsMutex held.
+     */
+    void UpdateDocumentFacts();
+
     ///////////////////////////////
     // PRIVATE MEMBER VARIABLES
     ///////////////////////////////
@@ -122,6 +169,32 @@ private:
      */
     const QHash<QString, Resource *> &m_Resources;
     QString m_TOCCache;
+
+    /**
+     * The cached document facts and headings, and the
+     * text revision they were gathered from.
+     */
+    XhtmlDoc::DocumentFacts m_Facts;
+    QList<Headings::Heading> m_Headings;
+    int m_FactsRevision;
+
+    QList<XhtmlDoc::XMLElement> m_LinkElements;
+    int m_LinkElementsRevision;
+
+    /**
+     * Guards the document facts caches since they are
+     * filled from QtConcurrent workers.
+     */
+    QMutex m_FactsMutex;
+
+    /**
+     * The cached well-formedness verdict and the text revision
+     * it was computed for. Kept apart from the facts so a save
+     * does not wait on a facts rebuild.
+     */
+    XhtmlDoc::WellFormedError m_WellFormedError;
+    int m_WellFormedRevision;
+    QMutex m_WellFormedMutex;
 };
 
 #endif // HTMLRESOURCE_H
@@ -366,7 +366,7 @@ void NavProcessor::SetPageList(const QList<NavPageListEntry> & pagelist)
         
     bool found_pagelist = false;
     // QWriteLocker locker(&m_NavResource->GetLock());
-    GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
+    GumboInterface gi = GumboInterface(m_NavResource->GetUtf8Text(), "3.0");
     gi.parse();
     QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
     for (int i = 0; i < nav_nodes.length(); ++i) {
@@ -409,7 +409,7 @@ void NavProcessor::SetLandmarks(const QList<NavLandmarkEntry> & landlist)
 
     bool found_landmarks = false;
     // QWriteLocker locker(&m_NavResource->GetLock());
-    GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
+    GumboInterface gi = GumboInterface(m_NavResource->GetUtf8Text(), "3.0");
     gi.parse();
     const QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
     for (int i = 0; i < nav_nodes.length(); ++i) {
@@ -453,7 +453,7 @@ void NavProcessor::SetTOC(const QList<NavTOCEntry> & toclist)
 
     bool found_toc = false;
     // QWriteLocker locker(&m_NavResource->GetLock());
-    GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
+    GumboInterface gi = GumboInterface(m_NavResource->GetUtf8Text(), "3.0");
     gi.parse();
     const QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
     for (int i = 0; i < nav_nodes.length(); ++i) {
@@ -20,10 +20,11 @@
 **
 *************************************************************************/
 
-#include "Misc/EmbeddedPython.h"
+#include <QUrl>
+#include <QVector>
+#include <QDebug>
 #include "Misc/Utility.h"
 #include "ResourceObjects/OPFParser.h"
-#include <QDebug>
 
 // Note: all hrefs/urls should always be kept in URLEncoded form
 // as decoding urls before splitting into component parts can lead
@@ -376,76 +377,249 @@ QString BindingsEntry::convert_to_xml() const
 }
 
 
-void OPFParser::parse(const QString& source)
-{
-    int rv = 0;
-    QString traceback;
-
-    QList<QVariant> args;
-    args.append(QVariant(source));
-    EmbeddedPython* epp = EmbeddedPython::instance();
-    QVariant res = epp->runInPython( QString("opf_newparser"), QString("parseopf"), args, &rv, traceback, true);
-    if (rv) fprintf(stderr, "setext parseropf error %d traceback %s\n",rv, traceback.toStdString().c_str());
-
-    PyObjectPtr mpo = PyObjectPtr(res);
+// Native port of the tag tokenizer in python3lib/opf_newparser.py.
+// The opf is deliberately not run through a real xml parser here since
+// entities and attribute values must be kept exactly as written and
+// damaged opfs must still parse as well as they did under python.
 
-    args.clear();
-    res = epp->callPyObjMethod(mpo, QString("get_package"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext package error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    m_package = PackageEntry(res);
+static const QStringList OPF_PARENT_TAGS = QStringList() << "package" << "metadata" << "dc-metadata"
+                                                         << "x-metadata" << "manifest" << "spine"
+                                                         << "tours" << "guide" << "bindings";
 
-    res = epp->callPyObjMethod(mpo, QString("get_metadata_attr"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext meta_attr error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    m_metans = MetaNSEntry(res);
+enum OPFTagType {
+    OPFTag_Begin,
+    OPFTag_End,
+    OPFTag_Single,
+    OPFTag_Special
+};
 
-    res = epp->callPyObjMethod(mpo, QString("get_metadata"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext metadata error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    m_metadata.clear();
-    QList<QVariant> lst = res.toList();
-    foreach(QVariant qv, lst) {
-        m_metadata.append(MetaEntry(qv));
+// returns the next chunk of text or the next complete tag starting at pos
+// and advances pos past it, returns false when the source is exhausted
+static bool NextOPFToken(const QString &opf, int &pos, QString &text, QString &tag)
+{
+    int n = opf.length();
+    int p = pos;
+    text.clear();
+    tag.clear();
+    if (p >= n) return false;
+    if (opf.at(p) != '<') {
+        int res = opf.indexOf('<', p);
+        if (res == -1) res = n;
+        pos = res;
+        text = opf.mid(p, res - p);
+        return true;
+    }
+    int te;
+    // handle comment as a special case
+    if (opf.midRef(p, 4) == "<!--") {
+        te = opf.indexOf("-->", p + 1);
+        if (te != -1) te = te + 2;
+    } else {
+        te = opf.indexOf('>', p + 1);
+        int ntb = opf.indexOf('<', p + 1);
+        if ((ntb != -1) && (te != -1) && (ntb < te)) {
+            pos = ntb;
+            text = opf.mid(p, ntb - p);
+            return true;
+        }
     }
+    // an unterminated tag or comment simply runs to the end of the source
+    if (te == -1) te = n - 1;
+    pos = te + 1;
+    tag = opf.mid(p, te + 1 - p);
+    return true;
+}
 
-    m_idpos.clear();
-    m_hrefpos.clear();
+// parses a tag to identify its type, its lowercased name and its attributes
+static OPFTagType ParseOPFTag(const QString &s, QString &tname, TagAtts &tattr)
+{
+    int n = s.length();
+    int p = 1;
+    bool is_end = false;
+    while (p < n && s.at(p) == ' ') p++;
+    if (p < n && s.at(p) == '/') {
+        is_end = true;
+        p++;
+        while (p < n && s.at(p) == ' ') p++;
+    }
+    int b = p;
+    // comments may have no spaces to delimit the name
+    if (s.midRef(b).startsWith("!--")) {
+        tname = "!--";
+        return OPFTag_Special;
+    }
+    while (p < n) {
+        QChar c = s.at(p);
+        if (c == '>' || c == '/' || c == ' ' || c == '"' || c == '\'' || c == '\r' || c == '\n') break;
+        p++;
+    }
+    tname = s.mid(b, p - b).toLower();
+    if ((tname == "?xml") || (tname == "!doctype")) return OPFTag_Special;
+    if (is_end) return OPFTag_End;
+
+    // parse any attributes of begin or single tags
+    while (s.indexOf('=', p) != -1) {
+        while (p < n && s.at(p) == ' ') p++;
+        b = p;
+        while (p < n && s.at(p) != '=') p++;
+        QString aname = s.mid(b, p - b).toLower();
+        int e = aname.length();
+        while (e > 0 && aname.at(e - 1) == ' ') e--;
+        aname.truncate(e);
+        p++;
+        while (p < n && s.at(p) == ' ') p++;
+        QString val;
+        if (p < n && (s.at(p) == '"' || s.at(p) == '\'')) {
+            QChar qt = s.at(p);
+            p++;
+            b = p;
+            // try to work around missing end quotes
+            while (p < n && s.at(p) != '>' && s.at(p) != '<' && s.at(p) != qt) p++;
+            val = s.mid(b, p - b);
+            p++;
+        } else {
+            b = p;
+            while (p < n && s.at(p) != '>' && s.at(p) != '/' && s.at(p) != ' ') p++;
+            val = s.mid(b, p - b);
+        }
+        tattr.insert(aname, val);
+    }
+    if (s.indexOf('/', p) >= 0) return OPFTag_Single;
+    return OPFTag_Begin;
+}
 
-    res = epp->callPyObjMethod(mpo, QString("get_manifest"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext manifest error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    m_manifest.clear();
-    lst = res.toList();
-    for (int i = 0; i < lst.count(); i++) {
-        ManifestEntry me = ManifestEntry(lst.at(i));
-        m_idpos[me.m_id] = i;
-        m_hrefpos[me.m_href] = i;
-        m_manifest.append(me);
+// same as hrefutils urldecodepart followed by urlencodepart
+static QString ReencodeHrefPart(const QString &href)
+{
+    QString decoded = QUrl::fromPercentEncoding(href.toUtf8());
+    QString result;
+    QVector<uint> codepoints = decoded.toUcs4();
+    foreach(uint cp, codepoints) {
+        QString ch = QString::fromUcs4(&cp, 1);
+        if (Utility::NeedToPercentEncode(cp)) {
+            QByteArray bytes = ch.toUtf8();
+            for (int j = 0; j < bytes.size(); j++) {
+                result.append(QString("%%1").arg((uint)(uchar) bytes.at(j), 2, 16, QChar('0')));
+            }
+        } else {
+            result.append(ch);
+        }
     }
+    return result;
+}
 
-    res = epp->callPyObjMethod(mpo, QString("get_spine_attr"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext spineattr error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    m_spineattr = SpineAttrEntry(res);
 
-    res = epp->callPyObjMethod(mpo, QString("get_spine"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext spine error %d traceback %s\n",rv, traceback.toStdString().c_str());
+void OPFParser::parse(const QString& source)
+{
+    // a missing package tag leaves everything empty just as before
+    m_package = PackageEntry("", "", QStringList(), QStringList());
+    m_metans = MetaNSEntry();
+    m_metadata.clear();
+    m_manifest.clear();
+    m_spineattr = SpineAttrEntry();
     m_spine.clear();
-    lst = res.toList();
-    foreach(QVariant qv, lst) {
-        m_spine.append(SpineEntry(qv));
-    }
-
-    res = epp->callPyObjMethod(mpo, QString("get_guide"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext guide error %d traceback %s\n",rv, traceback.toStdString().c_str());
     m_guide.clear();
-    lst = res.toList();
-    foreach(QVariant qv, lst) {
-        m_guide.append(GuideEntry(qv));
-    }
-
-    res = epp->callPyObjMethod(mpo, QString("get_bindings"), args, &rv, traceback);
-    if (rv) fprintf(stderr, "setext bindings error %d traceback %s\n",rv, traceback.toStdString().c_str());
     m_bindings.clear();
-    lst = res.toList();
-    foreach(QVariant qv, lst) {
-        m_bindings.append(BindingsEntry(qv));
+    m_idpos.clear();
+    m_hrefpos.clear();
+
+    bool ns_remap = false;
+    int cnt = 0;
+    QStringList prefix;
+    QString tcontent;
+    TagAtts last_tattr;
+    int pos = 0;
+    QString text;
+    QString tag;
+
+    while (NextOPFToken(source, pos, text, tag)) {
+        if (tag.isEmpty()) {
+            int e = text.length();
+            while (e > 0 && (text.at(e - 1) == ' ' || text.at(e - 1) == '\r' || text.at(e - 1) == '\n')) e--;
+            tcontent = text.left(e);
+            continue;
+        }
+        QString tname;
+        TagAtts tattr;
+        OPFTagType ttype = ParseOPFTag(tag, tname, tattr);
+        // remap opf namespace on tags if needed
+        if (tname.startsWith("opf:")) {
+            ns_remap = true;
+            tname = tname.mid(4);
+        }
+        bool is_parent = OPF_PARENT_TAGS.contains(tname);
+        if (ttype == OPFTag_Begin) {
+            tcontent.clear();
+            prefix.append(tname);
+            if (!is_parent) {
+                last_tattr = tattr;
+                continue;
+            }
+        } else {
+            if (ttype == OPFTag_End) {
+                if (!prefix.isEmpty()) prefix.removeLast();
+                tattr = last_tattr;
+                last_tattr = TagAtts();
+            } else if (ttype == OPFTag_Single) {
+                tcontent.clear();
+            }
+            if ((ttype != OPFTag_Single) && ((ttype != OPFTag_End) || is_parent)) {
+                tcontent.clear();
+                continue;
+            }
+        }
+
+        // handle the yielded tag
+        QString tprefix = prefix.join(".");
+        if (tname == "package") {
+            QString ver = tattr.value("version", "2.0");
+            QString uid = tattr.value("unique-identifier", "bookid");
+            tattr.remove("version");
+            tattr.remove("unique-identifier");
+            if (ns_remap && tattr.contains("xmlns:opf")) {
+                tattr.remove("xmlns:opf");
+                tattr["xmlns"] = "http://www/idpf.org/2007/opf";
+            }
+            m_package = PackageEntry(ver, uid, tattr.keys(), tattr.values());
+        } else if (tname == "metadata") {
+            if (ns_remap && !tattr.contains("xmlns:opf")) {
+                tattr["xmlns:opf"] = "http://www/idpf.org/2007/opf";
+            }
+            m_metans = MetaNSEntry(tattr.keys(), tattr.values());
+        } else if ((tname == "meta") || (tname == "link") || 
+                   (tname.startsWith("dc:") && tprefix.contains("metadata"))) {
+            m_metadata.append(MetaEntry(tname, tcontent, tattr.keys(), tattr.values()));
+        } else if ((tname == "item") && tprefix.contains("manifest")) {
+            QString nid = QString("xid%1").arg(cnt, 3, 10, QChar('0'));
+            cnt++;
+            QString id = tattr.value("id", nid);
+            // must keep all hrefs in encoded form
+            // if relative, then no fragments so decode and then encode for safety
+            QString href = tattr.value("href", "");
+            if (!href.contains(':')) {
+                href = ReencodeHrefPart(href);
+            }
+            QString mtype = tattr.value("media-type", "");
+            tattr.remove("id");
+            tattr.remove("href");
+            tattr.remove("media-type");
+            int i = m_manifest.count();
+            m_idpos[id] = i;
+            m_hrefpos[href] = i;
+            m_manifest.append(ManifestEntry(id, href, mtype, tattr.keys(), tattr.values()));
+        } else if (tname == "spine") {
+            m_spineattr = SpineAttrEntry(tattr.keys(), tattr.values());
+        } else if ((tname == "itemref") && tprefix.contains("spine")) {
+            QString idref = tattr.value("idref", "");
+            tattr.remove("idref");
+            m_spine.append(SpineEntry(idref, tattr.keys(), tattr.values()));
+        } else if ((tname == "reference") && tprefix.contains("guide")) {
+            // must keep all hrefs in encoded form
+            m_guide.append(GuideEntry(tattr.value("type", ""), tattr.value("title", ""), tattr.value("href", "")));
+        } else if ((tname == "mediatype") && tprefix.contains("bindings")) {
+            m_bindings.append(BindingsEntry(tattr.value("media-type", ""), tattr.value("handler", "")));
+        }
+        tcontent.clear();
     }
 }
 
@@ -127,7 +127,10 @@ OPFResource::OPFResource(const QString &mainfolder,
 			 QObject *parent)
   : XMLResource(mainfolder, fullfilepath, parent),
     m_NavResource(NULL),
-    m_WarnedAboutVersion(false)
+    m_WarnedAboutVersion(false),
+    m_ModelMutex(QMutex::Recursive),
+    m_ModelRevision(-1),
+    m_SpineIndexValid(false)
 {
     FillWithDefaultText(version);
     // Make sure the file exists on disk.
@@ -199,9 +202,7 @@ bool OPFResource::LoadFromDisk()
 QList<Resource*> OPFResource::GetSpineOrderResources( const QList<Resource *> &resources)
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     const QHash<QString, Resource*> id_mapping = GetManifestIDResourceMapping(resources, p);
     QList<Resource *> spine_order;
     for (int i = 0; i < p.m_spine.count(); ++i) {
@@ -216,9 +217,7 @@ QList<Resource*> OPFResource::GetSpineOrderResources( const QList<Resource *> &r
 QHash <Resource *, int>  OPFResource::GetReadingOrderAll( const QList <Resource *> resources)
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QHash <Resource *, int> reading_order;
     QHash<QString, int> id_order;
     for (int i = 0; i < p.m_spine.count(); ++i) {
@@ -235,26 +234,37 @@ QHash <Resource *, int>  OPFResource::GetReadingOrderAll( const QList <Resource
 int OPFResource::GetReadingOrder(const HTMLResource *html_resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
-    const Resource *resource = static_cast<const Resource *>(html_resource);
-    QString resource_id = GetResourceManifestID(resource, p);
-    for (int i = 0; i < p.m_spine.count(); ++i) {
-        QString idref = p.m_spine.at(i).m_idref;
-        if (resource_id == idref) {
-            return i;
+    return GetSpinePositionIndex().value(html_resource->GetRelativePath(), -1);
+}
+
+
+QHash<QString, int> OPFResource::GetSpinePositionIndex() const
+{
+    QMutexLocker locker(&m_ModelMutex);
+    // makes sure the model is current, which invalidates the index if needed
+    GetParsedOPF();
+    if (!m_SpineIndexValid) {
+        m_SpineIndex.clear();
+        for (int i = 0; i < m_Model.m_spine.count(); ++i) {
+            int pos = m_Model.m_idpos.value(m_Model.m_spine.at(i).m_idref, -1);
+            if (pos > -1) {
+                QString apath = Utility::URLDecodePath(m_Model.m_manifest.at(pos).m_href);
+                QString bookpath = Utility::buildBookPath(apath, GetFolder());
+                // an item referenced twice keeps its first position
+                if (!m_SpineIndex.contains(bookpath)) {
+                    m_SpineIndex.insert(bookpath, i);
+                }
+            }
         }
+        m_SpineIndexValid = true;
     }
-    return -1;
+    return m_SpineIndex;
 }
 
 QString OPFResource::GetMainIdentifierValue() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     int i = GetMainIdentifier(p);
     if (i > -1) {
         return QString(p.m_metadata.at(i).m_content);
@@ -264,6 +274,9 @@ QString OPFResource::GetMainIdentifierValue() const
 
 void OPFResource::SaveToDisk(bool book_wide_save)
 {
+    if (book_wide_save && IsSavedToDisk()) {
+        return;
+    }
     QString source = ValidatePackageVersion(CleanSource::ProcessXML(GetText(),"application/oebps-package+xml"));
     // Work around for covers appearing on the Nook. Issue 942.
     source = source.replace(QRegularExpression("<meta content=\"([^\"]+)\" name=\"cover\""), "<meta name=\"cover\" content=\"\\1\"");
@@ -300,9 +313,7 @@ QString OPFResource::GetUUIDIdentifierValue()
 {
     EnsureUUIDIdentifierPresent();
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if(me.m_name.startsWith("dc:identifier")) {
@@ -322,9 +333,7 @@ QString OPFResource::GetUUIDIdentifierValue()
 void OPFResource::EnsureUUIDIdentifierPresent()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if(me.m_name.startsWith("dc:identifier")) {
@@ -348,9 +357,7 @@ void OPFResource::EnsureUUIDIdentifierPresent()
 QString OPFResource::AddNCXItem(const QString &ncx_path, QString id)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString ncx_bkpath = ncx_path.right(ncx_path.length() - GetFullPathToBookFolder().length() - 1);
     QString ncx_rel_path = Utility::buildRelativePath(GetRelativePath(), ncx_bkpath);
     int n = p.m_manifest.count();
@@ -369,9 +376,7 @@ QString OPFResource::AddNCXItem(const QString &ncx_path, QString id)
 void OPFResource::UpdateNCXOnSpine(const QString &new_ncx_id)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString ncx_id = p.m_spineattr.m_atts.value(QString("toc"),"");
     if (new_ncx_id != ncx_id) {
         p.m_spineattr.m_atts[QString("toc")] = new_ncx_id;
@@ -382,9 +387,7 @@ void OPFResource::UpdateNCXOnSpine(const QString &new_ncx_id)
 void OPFResource::RemoveNCXOnSpine()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     p.m_spineattr.m_atts.remove("toc");
     UpdateText(p);
 }
@@ -393,9 +396,7 @@ void OPFResource::RemoveNCXOnSpine()
 void OPFResource::UpdateNCXLocationInManifest(const NCXResource *ncx)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString ncx_id = p.m_spineattr.m_atts.value(QString("toc"), "");
     int pos = p.m_idpos.value(ncx_id, -1);
     if (pos > -1) {
@@ -414,9 +415,7 @@ void OPFResource::UpdateNCXLocationInManifest(const NCXResource *ncx)
 void OPFResource::AddSigilVersionMeta()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if ((me.m_name == "meta") && (me.m_atts.contains("name"))) {  
@@ -441,9 +440,7 @@ void OPFResource::AddSigilVersionMeta()
 bool OPFResource::IsCoverImage(const ImageResource *image_resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString resource_id = GetResourceManifestID(image_resource, p);
     return IsCoverImageCheck(resource_id, p);
 }
@@ -463,9 +460,7 @@ bool OPFResource::IsCoverImageCheck(QString resource_id, const OPFParser & p) co
 bool OPFResource::CoverImageExists() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     return GetCoverMeta(p) > -1;
 }
 
@@ -481,9 +476,7 @@ void OPFResource::AutoFixWellFormedErrors()
 QStringList OPFResource::GetSpineOrderBookPaths() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QStringList book_paths_in_reading_order;
     for (int i=0; i < p.m_spine.count(); ++i) {
         SpineEntry sp = p.m_spine.at(i);
@@ -521,9 +514,7 @@ QString OPFResource::GetPrimaryBookLanguage() const
 QList<MetaEntry> OPFResource::GetDCMetadata() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QList<MetaEntry> metadata;
     for (int i=0; i < p.m_metadata.count(); ++i) {
         if (p.m_metadata.at(i).m_name.startsWith("dc:")) {
@@ -550,9 +541,7 @@ QStringList OPFResource::GetDCMetadataValues(QString text) const
 void OPFResource::SetDCMetadata(const QList<MetaEntry> &metadata)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     // this will not work with refines so it needs to be fixed
     RemoveDCElements(p);
     foreach(MetaEntry book_meta, metadata) {
@@ -567,9 +556,7 @@ void OPFResource::SetDCMetadata(const QList<MetaEntry> &metadata)
 void OPFResource::AddResource(const Resource *resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     ManifestEntry me;
     me.m_id = GetUniqueID(GetValidID(resource->Filename()),p);
     me.m_href = Utility::URLEncodePath(GetRelativePathToResource(resource));
@@ -674,9 +661,7 @@ void OPFResource::AddCoverMetaForImage(const Resource *resource, OPFParser &p)
 void OPFResource::RemoveResource(const Resource *resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     if (p.m_manifest.isEmpty()) return;
     QString href = Utility::URLEncodePath(GetRelativePathToResource(resource));
     int pos = p.m_hrefpos.value(href, -1);
@@ -721,9 +706,7 @@ void OPFResource::RemoveResource(const Resource *resource)
 void OPFResource::ClearSemanticCodesInGuide()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     foreach(GuideEntry ge, p.m_guide) {
         p.m_guide.removeAt(0);
     }
@@ -736,9 +719,7 @@ void OPFResource::AddGuideSemanticCode(HTMLResource *html_resource, QString new_
     //first get primary book language
     QString lang = GetPrimaryBookLanguage();
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString current_code = GetGuideSemanticCodeForResource(html_resource, p);
 
     if ((current_code != new_code) || !toggle) {
@@ -833,9 +814,7 @@ void OPFResource::SetGuideSemanticCodeForResource(QString code, const Resource *
 QString OPFResource::GetGuideSemanticCodeForResource(const Resource *resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     return GetGuideSemanticCodeForResource(resource, p);
 }
 
@@ -849,9 +828,7 @@ QString OPFResource::GetGuideSemanticNameForResource(Resource *resource)
 QHash <QString, QString>  OPFResource::GetSemanticCodeForPaths()
 {
   QReadLocker locker(&GetLock());
-  QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-  OPFParser p;
-  p.parse(source);
+  OPFParser p = GetParsedOPF();
 
   QHash <QString, QString> semantic_types;
   foreach(GuideEntry ge, p.m_guide) {
@@ -869,9 +846,7 @@ QHash <QString, QString>  OPFResource::GetSemanticCodeForPaths()
 QHash <QString, QString>  OPFResource::GetGuideSemanticNameForPaths()
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
 
     QHash <QString, QString> semantic_types;
     foreach(GuideEntry ge, p.m_guide) {
@@ -900,9 +875,7 @@ QHash <QString, QString>  OPFResource::GetGuideSemanticNameForPaths()
 void OPFResource::SetResourceAsCoverImage(ImageResource *image_resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString resource_id = GetResourceManifestID(image_resource, p);
 
     // First deal with any previous covers by removing 
@@ -937,9 +910,7 @@ void OPFResource::SetResourceAsCoverImage(ImageResource *image_resource)
 void OPFResource::UpdateSpineOrder(const QList<::HTMLResource *> html_files)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QList<SpineEntry> new_spine;
     foreach(HTMLResource * html_resource, html_files) {
         const Resource *resource = static_cast<const Resource *>(html_resource);
@@ -969,9 +940,7 @@ void OPFResource::UpdateSpineOrder(const QList<::HTMLResource *> html_files)
 void OPFResource::ResourceRenamed(const Resource *resource, QString old_full_path)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     // first convert old_full_path to old_bkpath
     QString old_bkpath = old_full_path.right(old_full_path.length() - GetFullPathToBookFolder().length() - 1);
     QString old_href = Utility::URLEncodePath(Utility::buildRelativePath(GetRelativePath(), old_bkpath));
@@ -1027,9 +996,7 @@ void OPFResource::ResourceRenamed(const Resource *resource, QString old_full_pat
 void OPFResource::ResourceMoved(const Resource *resource, QString old_full_path)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     // first convert old_full_path to old_bkpath
     QString old_bkpath = old_full_path.right(old_full_path.length() - GetFullPathToBookFolder().length() - 1);
     QString old_href = Utility::URLEncodePath(Utility::buildRelativePath(GetRelativePath(), old_bkpath));
@@ -1194,9 +1161,7 @@ QString OPFResource::AddModificationDateMeta()
     datetime = local.toString(Qt::ISODate);
 
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
 
     QString epubversion = GetEpubVersion();
     if (epubversion.startsWith('3')) {
@@ -1311,9 +1276,32 @@ QString OPFResource::GetFileMimetype(const QString &filepath) const
 }
 
 
+OPFParser OPFResource::GetParsedOPF() const
+{
+    QMutexLocker locker(&m_ModelMutex);
+    // read the revision before the text so a concurrent change forces a reparse next time
+    int revision = GetTextRevision();
+    if (revision != m_ModelRevision) {
+        QString source = CleanSource::ProcessXML(TextResource::GetText(),"application/oebps-package+xml");
+        OPFParser p;
+        p.parse(source);
+        m_Model = p;
+        m_ModelRevision = revision;
+        m_SpineIndexValid = false;
+    }
+    // OPFParser only holds implicitly shared Qt containers so this copy is cheap
+    return m_Model;
+}
+
+
 void OPFResource::UpdateText(const OPFParser &p)
 {
+    QMutexLocker locker(&m_ModelMutex);
     TextResource::SetText(p.convert_to_xml());
+    // the new text is exactly the model so it need not be parsed again
+    m_Model = p;
+    m_ModelRevision = GetTextRevision();
+    m_SpineIndexValid = false;
 }
 
 
@@ -1341,9 +1329,7 @@ QString OPFResource::ValidatePackageVersion(const QString& source)
 void OPFResource::UpdateManifestProperties(const QList<Resource*> resources)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     if (p.m_package.m_version != "3.0") {
         return;
     }
@@ -1388,9 +1374,7 @@ QString OPFResource::GetManifestPropertiesForResource(const Resource * resource)
     QString properties;
     if (!resource) return properties;
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     if (!p.m_package.m_version.startsWith("3")) {
         return properties;
     }
@@ -1412,9 +1396,7 @@ QHash <QString, QString>  OPFResource::GetManifestPropertiesForPaths()
         return manifest_properties_all;
     }
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     foreach(ManifestEntry me, p.m_manifest) {
         QString apath = Utility::URLDecodePath(me.m_href);
         if (me.m_atts.contains("properties")){
@@ -1439,9 +1421,7 @@ void OPFResource::SetNavResource(HTMLResource * nav_resource)
     // Make sure the proper nav property is set in the opf manifest
     if (m_NavResource) { 
         QWriteLocker locker(&GetLock());
-        QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-        OPFParser p;
-        p.parse(source);
+        OPFParser p = GetParsedOPF();
         QString href = Utility::URLEncodePath(GetRelativePathToResource(m_NavResource));
         int pos = p.m_hrefpos.value(href, -1);
         if ((pos >= 0) && (pos < p.m_manifest.count())) {
@@ -1457,9 +1437,7 @@ void OPFResource::SetNavResource(HTMLResource * nav_resource)
 void OPFResource::SetItemRefLinear(Resource * resource, bool linear)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedOPF();
     QString resource_href_path = Utility::URLEncodePath(GetRelativePathToResource(resource));
     int pos = p.m_hrefpos.value(resource_href_path, -1);
     QString item_id = "";
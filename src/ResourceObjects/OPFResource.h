@@ -26,6 +26,7 @@
 #define OPFRESOURCE_H
 
 #include <memory>
+#include <QtCore/QMutex>
 #include "Misc/GuideItems.h"
 #include "ResourceObjects/XMLResource.h"
 #include "ResourceObjects/OPFParser.h"
@@ -105,6 +106,14 @@ public:
 
     QStringList GetSpineOrderBookPaths() const;
 
+    /**
+     * Returns the reading order position of each book path in the spine.
+     * The index is cached and only rebuilt after the OPF changes.
+     *
+     * @return A hash of book path to spine position.
+     */
+    QHash<QString, int> GetSpinePositionIndex() const;
+
     void SetItemRefLinear(Resource * resource, bool linear);
 
     /**
@@ -175,6 +184,14 @@ public slots:
 
 private:
 
+    /**
+     * Returns the parsed OPF, reparsing only if the text
+     * changed since the model was last synced with it.
+     *
+     * @return A copy of the cached model.
+     */
+    OPFParser GetParsedOPF() const;
+
     /**
      * Determines if a cover image exists.
      *
@@ -262,6 +279,17 @@ private:
 
     HTMLResource * m_NavResource;
     bool m_WarnedAboutVersion;
+
+    /**
+     * The parsed OPF, kept in sync with the text revision.
+     * Mutations write the text and the model together.
+     */
+    mutable QMutex m_ModelMutex;
+    mutable OPFParser m_Model;
+    mutable int m_ModelRevision;
+
+    mutable QHash<QString, int> m_SpineIndex;
+    mutable bool m_SpineIndexValid;
 };
 
 #endif // OPFRESOURCE_H
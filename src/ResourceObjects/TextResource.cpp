@@ -20,7 +20,9 @@
 **
 *************************************************************************/
 
+#include <QtCore/QDateTime>
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QString>
 #include <QtCore/QThread>
 #include <QtCore/QTimer>
@@ -36,9 +38,14 @@ TextResource::TextResource(const QString &mainfolder, const QString &fullfilepat
     Resource(mainfolder, fullfilepath, parent),
     m_CacheInUse(false),
     m_TextDocument(new TextDocument(this)),
-    m_IsLoaded(false)
+    m_IsLoaded(false),
+    m_TextRevision(0),
+    m_SavedRevision(-1),
+    m_SavedModTime(0),
+    m_Utf8Revision(-1)
 {
     m_TextDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_TextDocument));
+    connect(m_TextDocument, SIGNAL(contentsChanged()), this, SLOT(BumpTextRevision()));
     connect(m_TextDocument, SIGNAL(contentsChanged()), this, SIGNAL(Modified()));
 }
 
@@ -55,6 +62,20 @@ QString TextResource::GetText() const
 }
 
 
+QByteArray TextResource::GetUtf8Text() const
+{
+    QMutexLocker locker(&m_Utf8Mutex);
+    // read the revision before the text so a concurrent change
+    // can only ever leave us with a cache that is rebuilt next time
+    int revision = GetTextRevision();
+    if (revision != m_Utf8Revision) {
+        m_Utf8Text = GetText().toUtf8();
+        m_Utf8Revision = revision;
+    }
+    return m_Utf8Text;
+}
+
+
 void TextResource::SetText(const QString &text)
 {
     //   We need to delay updating the QTextDocument if SetText has
@@ -72,6 +93,7 @@ void TextResource::SetText(const QString &text)
     } else {
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        m_TextRevision.ref();
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
@@ -102,14 +124,19 @@ void TextResource::SaveToDisk(bool book_wide_save)
         // here because that causes problems with epub export
         // when the user has not changed the text file.
         // (some text files have placeholder text on disk)
+        // Instead a book wide save skips only text we wrote out ourselves.
+        if (book_wide_save && IsSavedToDisk()) {
+            return;
+        }
 
         // But we always want to save the most up to date version
+        // (read the revision first so a racing change is saved next time)
+        int revision = GetTextRevision();
+        Utility::WriteUnicodeTextFile(GetText(), GetFullPath());
 
-        if (m_CacheInUse) {
-            Utility::WriteUnicodeTextFile(m_Cache, GetFullPath());
-        } else {
-            Utility::WriteUnicodeTextFile(GetText(), GetFullPath());
-        }
+        const QDateTime lastModifiedDate = QFileInfo(GetFullPath()).lastModified();
+        m_SavedModTime = lastModifiedDate.isValid() ? lastModifiedDate.toMSecsSinceEpoch() : 0;
+        m_SavedRevision.storeRelease(revision);
     }
 
     if (!book_wide_save) {
@@ -163,6 +190,7 @@ bool TextResource::LoadFromDisk()
         const QString &text = Utility::ReadUnicodeTextFile(GetFullPath());
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        m_TextRevision.ref();
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
@@ -187,7 +215,13 @@ void TextResource::DelayedUpdateToTextDocument()
         return;
     }
 
+    bool saved = m_SavedRevision.loadAcquire() == GetTextRevision();
     SetTextInternal(m_Cache);
+
+    // The document now holds the very text that was written out
+    if (saved) {
+        m_SavedRevision.storeRelease(GetTextRevision());
+    }
 }
 
 
@@ -206,3 +240,26 @@ bool TextResource::IsLoaded()
 {
     return m_IsLoaded;
 }
+
+int TextResource::GetTextRevision() const
+{
+    return m_TextRevision.loadAcquire();
+}
+
+
+bool TextResource::IsSavedToDisk() const
+{
+    if (m_SavedRevision.loadAcquire() != GetTextRevision()) {
+        return false;
+    }
+    QFileInfo fi(GetFullPath());
+    const QDateTime lastModifiedDate = fi.lastModified();
+    return fi.exists() && lastModifiedDate.isValid() &&
+           (lastModifiedDate.toMSecsSinceEpoch() == m_SavedModTime);
+}
+
+
+void TextResource::BumpTextRevision()
+{
+    m_TextRevision.ref();
+}
@@ -24,6 +24,8 @@
 #ifndef TEXTRESOURCE_H
 #define TEXTRESOURCE_H
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QByteArray>
 #include <QtCore/QMutex>
 #include "Misc/TextDocument.h"
 #include "ResourceObjects/Resource.h"
@@ -57,6 +59,17 @@ public:
      */
     virtual QString GetText() const;
 
+    /**
+     * Returns the text encoded as UTF-8.
+     *
+     * The encoding is cached per text revision and the returned array
+     * is implicitly shared, so any number of parsers and scanners can
+     * use the same buffer without transcoding the text again.
+     *
+     * @return The resource text as UTF-8.
+     */
+    QByteArray GetUtf8Text() const;
+
     /**
      * Sets the text of the resource, replacing the stored content.
      */
@@ -84,6 +97,27 @@ public:
 
     bool IsLoaded();
 
+    /**
+     * Returns the revision of the resource text. The revision is
+     * bumped after every change of the text, so caches of data
+     * derived from the text can compare it to know when they are stale.
+     *
+     * @return The current text revision.
+     */
+    int GetTextRevision() const;
+
+    /**
+     * Returns true if the file on disk already holds the current text,
+     * that is the text has not changed since we last wrote it and nobody
+     * else has touched the file since. Book wide saves use this to skip
+     * rewriting unchanged files.
+     *
+     * Text that was only read from disk is never considered saved, since
+     * the decoded text may legitimately differ from the bytes on disk
+     * (encoding, line endings, placeholder content).
+     */
+    bool IsSavedToDisk() const;
+
     // inherited
     virtual ResourceType Type() const;
 
@@ -98,6 +132,11 @@ private slots:
      */
     void DelayedUpdateToTextDocument();
 
+    /**
+     * Moves the text revision on after the text document changed.
+     */
+    void BumpTextRevision();
+
 private:
 
     /**
@@ -133,6 +172,26 @@ private:
     TextDocument *m_TextDocument;
 
     bool m_IsLoaded;
+
+    /**
+     * Incremented every time the text changes. @see GetTextRevision()
+     */
+    QAtomicInt m_TextRevision;
+
+    /**
+     * The text revision last written by SaveToDisk() or -1 if none,
+     * and the modification time the file had right after that write.
+     */
+    QAtomicInt m_SavedRevision;
+    qint64 m_SavedModTime;
+
+    /**
+     * The UTF-8 encoding of the text and the revision it was made from.
+     * @see GetUtf8Text()
+     */
+    mutable QByteArray m_Utf8Text;
+    mutable int m_Utf8Revision;
+    mutable QMutex m_Utf8Mutex;
 };
 
 #endif // TEXTRESOURCE_H
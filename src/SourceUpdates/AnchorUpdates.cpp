@@ -104,7 +104,7 @@ void AnchorUpdates::UpdateAnchorsInOneFile(HTMLResource *html_resource,
     Q_ASSERT(html_resource);
     QWriteLocker locker(&html_resource->GetLock());
     QString version = html_resource->GetEpubVersion();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), version);
+    GumboInterface gi = GumboInterface(html_resource->GetUtf8Text(), version);
     gi.parse();
     const QList<GumboNode*> anchor_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_A);
     const QString &resource_bookpath = html_resource->GetRelativePath();
@@ -166,7 +166,7 @@ void AnchorUpdates::UpdateExternalAnchorsInOneFile(HTMLResource *html_resource,
     QWriteLocker locker(&html_resource->GetLock());
     QString version = html_resource->GetEpubVersion();
     QString startdir = html_resource->GetFolder();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), version);
+    GumboInterface gi = GumboInterface(html_resource->GetUtf8Text(), version);
     gi.parse();
     const QList<GumboNode*> anchor_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_A);
 
@@ -217,7 +217,7 @@ void AnchorUpdates::UpdateAllAnchorsInOneFile(HTMLResource *html_resource,
     QWriteLocker locker(&html_resource->GetLock());
     QString startdir = html_resource->GetFolder();
     QString version = html_resource->GetEpubVersion();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), version);
+    GumboInterface gi = GumboInterface(html_resource->GetUtf8Text(), version);
     gi.parse();
     const QList<GumboNode*> anchor_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_A);
     bool is_changed = false;
@@ -32,6 +32,21 @@
 
 static const QChar FORWARD_SLASH = QChar::fromLatin1('/');
 
+// properties and rules that may hold urls, and the urls within them
+static const QString CSS_REFERENCE_PATTERN =
+    "(?:(?:src|background|background-image|list-style|list-style-image|border-image|border-image-source|content|(?:-webkit-)?shape-outside)\\s*:|@import)\\s*"
+    "("
+    "[^;\\}]*"
+    ")"
+    "(?:;|\\})";
+
+static const QString CSS_URL_PATTERN =
+    "(?:"
+    "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
+    "|"
+    "[\"']([^\\(\\)\"']*)[\"']"
+    ")";
+
 PerformCSSUpdates::PerformCSSUpdates(const QString &source, 
                      const QString& newbookpath, 
                      const QHash<QString, QString> &css_updates, 
@@ -55,19 +70,8 @@ QString PerformCSSUpdates::operator()()
     if (num_keys == 0) return result;
 
     // Now parse the text once looking for keys and replacing them where needed
-    QRegularExpression reference(
-        "(?:(?:src|background|background-image|list-style|list-style-image|border-image|border-image-source|content|(?:-webkit-)?shape-outside)\\s*:|@import)\\s*"
-        "("
-        "[^;\\}]*"
-        ")"
-        "(?:;|\\})");
-
-    QRegularExpression urls(
-        "(?:"
-        "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
-        "|"
-        "[\"']([^\\(\\)\"']*)[\"']"
-        ")");
+    QRegularExpression reference(CSS_REFERENCE_PATTERN);
+    QRegularExpression urls(CSS_URL_PATTERN);
 
     int start_index = 0;
     QRegularExpressionMatch mo = reference.match(result, start_index);
@@ -124,3 +128,29 @@ QString PerformCSSUpdates::operator()()
 
     return result;
 }
+
+
+QStringList PerformCSSUpdates::GetReferencedBookPaths(const QString &source, const QString &bookpath)
+{
+    QStringList bookpaths;
+    QString origDir = QFileInfo(bookpath).dir().path();
+    QRegularExpression reference(CSS_REFERENCE_PATTERN);
+    QRegularExpression urls(CSS_URL_PATTERN);
+    QRegularExpressionMatchIterator mi = reference.globalMatch(source);
+    while (mi.hasNext()) {
+        QRegularExpressionMatch mo = mi.next();
+        // walk every url of the property just as operator() does
+        QRegularExpressionMatchIterator fi = urls.globalMatch(mo.captured(1));
+        while (fi.hasNext()) {
+            QRegularExpressionMatch frag_mo = fi.next();
+            for (int j = 1; j <= urls.captureCount(); ++j) {
+                if (frag_mo.captured(j).trimmed().isEmpty()) {
+                    continue;
+                }
+                QString apath = Utility::URLDecodePath(frag_mo.captured(j));
+                bookpaths.append(Utility::buildBookPath(apath, origDir));
+            }
+        }
+    }
+    return bookpaths;
+}
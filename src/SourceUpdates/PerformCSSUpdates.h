@@ -25,6 +25,7 @@
 #define PERFORMCSSUPDATES_H
 
 #include <QtCore/QHash>
+#include <QtCore/QStringList>
 
 class QString;
 
@@ -37,6 +38,15 @@ public:
 
     QString operator()();
 
+    /**
+     * Returns the book paths of everything the given stylesheet
+     * source refers to with the urls operator() would update.
+     *
+     * @param source The css text.
+     * @param bookpath The book path the css is found at.
+     */
+    static QStringList GetReferencedBookPaths(const QString &source, const QString &bookpath);
+
 private:
 
     ///////////////////////////////
@@ -29,6 +29,7 @@
 #include <QRegularExpression>
 
 #include "BookManipulation/CleanSource.h"
+#include "BookManipulation/ReferenceIndex.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "Misc/HTMLEncodingResolver.h"
 #include "Misc/SettingsStore.h"
@@ -50,10 +51,25 @@
 
 #define NON_WELL_FORMED_MESSAGE "Cannot perform HTML updates since the file is not well formed"
 
+// a resource needs rewriting if it refers to a changed path or has moved itself
+template<class T>
+static QList<T *> AffectedResources(const QList<T *> &resources, const QSet<Resource *> &referring)
+{
+    QList<T *> affected;
+    foreach(T *resource, resources) {
+        if (referring.contains(resource) || (resource->GetCurrentBookRelPath() != resource->GetRelativePath())) {
+            affected.append(resource);
+        }
+    }
+    return affected;
+}
+
+
 QStringList UniversalUpdates::PerformUniversalUpdates(bool resources_already_loaded,
         const QList<Resource *> &resources,
         const QHash<QString, QString> &updates,
-        const QList<XMLResource *> &non_well_formed)
+        const QList<XMLResource *> &non_well_formed,
+        ReferenceIndex *reference_index)
 {
     QStringList updatekeys = updates.keys();
     QHash<QString, QString> html_updates;
@@ -84,6 +100,18 @@ QStringList UniversalUpdates::PerformUniversalUpdates(bool resources_already_loa
         }
     }
 
+    // The OPF manifest refers to every resource so it is always updated,
+    // as are the other xml files which the index does not cover.
+    if (resources_already_loaded && reference_index) {
+        reference_index->Refresh(resources);
+        const QSet<Resource *> referring = reference_index->GetReferringResources(updatekeys);
+        html_resources = AffectedResources(html_resources, referring);
+        css_resources = AffectedResources(css_resources, referring);
+        if (ncx_resource && AffectedResources(QList<NCXResource *>() << ncx_resource, referring).isEmpty()) {
+            ncx_resource = NULL;
+        }
+    }
+
     QFutureSynchronizer<void> sync;
     QFuture<QString> html_future;
     QFuture<void> css_future;
@@ -28,6 +28,7 @@ class HTMLResource;
 class XMLResource;
 class NCXResource;
 class OPFResource;
+class ReferenceIndex;
 class Resource;
 
 
@@ -37,10 +38,13 @@ class UniversalUpdates
 public:
 
     // Returns a list of errors if any that occurred while loading.
+    // Given a reference_index, loaded html, css and ncx files are only
+    // rewritten if they refer to one of the updated paths or have moved.
     static QStringList PerformUniversalUpdates(bool resources_already_loaded,
             const QList<Resource *> &resources,
             const QHash<QString, QString> &updates,
-            const QList<XMLResource *> &non_well_formed=QList<XMLResource *>());
+            const QList<XMLResource *> &non_well_formed=QList<XMLResource *>(),
+            ReferenceIndex *reference_index=NULL);
 
     static std::tuple <QHash<QString, QString>,
            QHash<QString, QString>,
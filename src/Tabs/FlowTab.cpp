@@ -624,7 +624,7 @@ bool FlowTab::IsDataWellFormed()
     // So lets play safe and have a fallback to use the resource text if CV is not loaded yet.
     XhtmlDoc::WellFormedError error = (m_wCodeView != NULL)
         ? XhtmlDoc::WellFormedErrorForSource(m_wCodeView->toPlainText(),version)
-        : XhtmlDoc::WellFormedErrorForSource(m_HTMLResource->GetText(),version);
+        : m_HTMLResource->WellFormedError();
     m_safeToLoad = error.line == -1;
     if (!m_safeToLoad) {
           m_WellFormedCheckComponent->DemandAttentionIfAllowed(error);
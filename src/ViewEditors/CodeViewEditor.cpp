@@ -24,6 +24,7 @@
 **
 *************************************************************************/
 
+#include <algorithm>
 #include <memory>
 
 #include <QtCore/QFileInfo>
@@ -95,6 +96,13 @@ CodeViewEditor::CodeViewEditor(HighlighterType high_type, bool check_spelling, Q
     m_reformatCSSEnabled(false),
     m_reformatHTMLEnabled(false),
     m_lastFindRegex(QString()),
+    m_FindIndexRevision(-1),
+    m_FindIndexStart(-1),
+    m_ContentsRevision(0),
+    m_TextSnapshotRevision(-1),
+    m_TagIndexValid(false),
+    m_TagDirtyStart(-1),
+    m_TagDirtyEnd(-1),
     m_spellingMapper(new QSignalMapper(this)),
     m_addSpellingMapper(new QSignalMapper(this)),
     m_addDictMapper(new QSignalMapper(this)),
@@ -152,7 +160,11 @@ QSize CodeViewEditor::sizeHint() const
 
 void CodeViewEditor::CustomSetDocument(TextDocument &document)
 {
+    disconnect(this->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(DocumentContentsChange(int, int, int)));
     setDocument(&document);
+    connect(&document, SIGNAL(contentsChange(int, int, int)), this, SLOT(DocumentContentsChange(int, int, int)));
+    m_ContentsRevision++;
+    m_TagIndexValid = false;
     document.setModified(false);
 
     if (m_Highlighter) {
@@ -671,10 +683,114 @@ int CodeViewEditor::textLength() const
 }
 
 // overrides document toPlainText to prevent loss of nbsp
+// The text is only rebuilt from the document after it changes,
+// otherwise callers share the last copy.
 QString CodeViewEditor::toPlainText() const
 {
-    TextDocument * doc = qobject_cast<TextDocument *> (document());
-    return doc->toText();
+    if (m_TextSnapshotRevision != m_ContentsRevision) {
+        TextDocument * doc = qobject_cast<TextDocument *> (document());
+        m_TextSnapshot = doc->toText();
+        m_TextSnapshotRevision = m_ContentsRevision;
+    }
+    return m_TextSnapshot;
+}
+
+
+void CodeViewEditor::DocumentContentsChange(int position, int chars_removed, int chars_added)
+{
+    m_ContentsRevision++;
+
+    if (!m_TagIndexValid) {
+        return;
+    }
+
+    // Drop the tags touched by the change and shift the ones after it.
+    QList<std::pair<int, int>>::iterator first = std::upper_bound(m_TagIndex.begin(), m_TagIndex.end(), position,
+        [](int value, const std::pair<int, int> &tag) { return value < tag.first + tag.second; });
+    QList<std::pair<int, int>>::iterator last = std::lower_bound(first, m_TagIndex.end(), position + chars_removed,
+        [](const std::pair<int, int> &tag, int value) { return tag.first < value; });
+    int delta = chars_added - chars_removed;
+    if (delta != 0) {
+        for (QList<std::pair<int, int>>::iterator it = last; it != m_TagIndex.end(); ++it) {
+            it->first += delta;
+        }
+    }
+    m_TagIndex.erase(first, last);
+
+    // Grow the region that must be rescanned to cover the change.
+    if (m_TagDirtyStart == -1) {
+        m_TagDirtyStart = position;
+        m_TagDirtyEnd = position + chars_added;
+    } else {
+        int dirty_end = m_TagDirtyEnd;
+        if (dirty_end > position + chars_removed) {
+            dirty_end += delta;
+        } else if (dirty_end > position) {
+            dirty_end = position + chars_added;
+        }
+        m_TagDirtyStart = qMin(m_TagDirtyStart, position);
+        m_TagDirtyEnd = qMax(dirty_end, position + chars_added);
+    }
+}
+
+
+void CodeViewEditor::UpdateTagIndex(const QString &text)
+{
+    static const QRegularExpression tag(XML_OPENING_TAG);
+
+    if (!m_TagIndexValid) {
+        m_TagIndex.clear();
+        QRegularExpressionMatchIterator i = tag.globalMatch(text);
+        while (i.hasNext()) {
+            QRegularExpressionMatch mo = i.next();
+            m_TagIndex.append(std::pair<int, int>(mo.capturedStart(), mo.capturedLength()));
+        }
+        m_TagIndexValid = true;
+        m_TagDirtyStart = -1;
+        return;
+    }
+
+    if (m_TagDirtyStart == -1) {
+        return;
+    }
+
+    // Tags ending before the changed region were matched without looking
+    // at it, so scanning can resume at the end of the last of them. Once a
+    // rescanned tag past the region lines up with an indexed one, the rest
+    // of the index is still correct.
+    int keep = std::upper_bound(m_TagIndex.constBegin(), m_TagIndex.constEnd(), m_TagDirtyStart,
+        [](int value, const std::pair<int, int> &tag) { return value < tag.first + tag.second; }) - m_TagIndex.constBegin();
+    int scan_from = keep > 0 ? m_TagIndex.at(keep - 1).first + m_TagIndex.at(keep - 1).second : 0;
+    int resume = keep;
+    bool in_sync = false;
+    QList<std::pair<int, int>> rescanned;
+
+    while (true) {
+        QRegularExpressionMatch mo = tag.match(text, scan_from);
+        if (!mo.hasMatch()) {
+            break;
+        }
+        std::pair<int, int> found(mo.capturedStart(), mo.capturedLength());
+        if (found.first >= m_TagDirtyEnd) {
+            while (resume < m_TagIndex.count() && m_TagIndex.at(resume).first < found.first) {
+                resume++;
+            }
+            if (resume < m_TagIndex.count() && m_TagIndex.at(resume) == found) {
+                in_sync = true;
+                break;
+            }
+        }
+        rescanned.append(found);
+        scan_from = found.first + found.second;
+    }
+
+    QList<std::pair<int, int>> tags = m_TagIndex.mid(0, keep);
+    tags.append(rescanned);
+    if (in_sync) {
+        tags.append(m_TagIndex.mid(resume));
+    }
+    m_TagIndex = tags;
+    m_TagDirtyStart = -1;
 }
 
 // overrides createMimeDataFromSelection()
@@ -776,6 +892,45 @@ SPCRE::MatchInfo CodeViewEditor::GetMisspelledWord(const QString &text, int star
     return match_info;
 }
 
+SPCRE::MatchInfo CodeViewEditor::GetLastMatchBefore(SPCRE *spcre,
+                                                    const QString &search_regex,
+                                                    const QString &text,
+                                                    int start,
+                                                    int end)
+{
+    if (end <= start) {
+        return SPCRE::MatchInfo();
+    }
+
+    int revision = m_ContentsRevision;
+    if (search_regex != m_FindIndexRegex || revision != m_FindIndexRevision || start != m_FindIndexStart) {
+        m_FindIndexOffsets.clear();
+        foreach(SPCRE::MatchInfo match, spcre->getEveryMatchInfo(text, start, text.length())) {
+            m_FindIndexOffsets.append(match.offset);
+        }
+        m_FindIndexRegex = search_regex;
+        m_FindIndexRevision = revision;
+        m_FindIndexStart = start;
+    }
+
+    // Find the indexed matches that end by the end of the search range.
+    // The last of them is our candidate, but cutting the text at end can
+    // change what matches near the cut, so rescan the cut text starting
+    // from the end of the indexed match before the candidate. SPCRE ignores
+    // this for patterns whose earlier matches can also change with the cut.
+    int relative_end = end - start;
+    QList<std::pair<int, int>>::const_iterator after = std::upper_bound(m_FindIndexOffsets.constBegin(), m_FindIndexOffsets.constEnd(), relative_end,
+        [](int value, const std::pair<int, int> &offset) { return value < offset.second; });
+    int candidates = after - m_FindIndexOffsets.constBegin();
+    int scan_from = start;
+    if (candidates >= 2) {
+        scan_from += m_FindIndexOffsets.at(candidates - 2).second;
+    }
+
+    return spcre->getLastMatchInfo(text, start, end, scan_from);
+}
+
+
 bool CodeViewEditor::FindNext(const QString &search_regex,
                               Searchable::Direction search_direction,
                               bool misspelled_words,
@@ -783,7 +938,7 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
                               bool wrap,
                               bool marked_text)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     SPCRE::MatchInfo match_info;
     QString txt = toPlainText();
     int start_offset = 0;
@@ -803,13 +958,13 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
         if (misspelled_words) {
             match_info = GetMisspelledWord(txt, 0, selection_offset, search_regex, search_direction);
         } else {
-            match_info = spcre->getLastMatchInfo(Utility::Substring(start, selection_offset, txt));
+            match_info = GetLastMatchBefore(spcre.data(), search_regex, txt, start, selection_offset);
         }
     } else {
         if (misspelled_words) {
             match_info = GetMisspelledWord(txt, selection_offset, txt.count(), search_regex, search_direction);
         } else {
-            match_info = spcre->getFirstMatchInfo(Utility::Substring(selection_offset, end, txt));
+            match_info = spcre->getFirstMatchInfo(txt, selection_offset, end);
         }
 
         start_offset = selection_offset;
@@ -847,8 +1002,8 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
 
 int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction direction, bool wrap, bool marked_text)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
-    QString text= toPlainText();
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+    const QString text = toPlainText();
     int start = 0;
     int end = text.length();
 
@@ -861,20 +1016,21 @@ int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction dir
     }
     if (!wrap) {
         if (direction == Searchable::Direction_Up) {
-            text = Utility::Substring(start, textCursor().position(), text);
+            end = textCursor().position();
         } else {
-            text = Utility::Substring(textCursor().position(), end, text);
+            start = textCursor().position();
         }
-    } else if (marked_text) {
-        text = Utility::Substring(start, end, text);
+    } else if (!marked_text) {
+        start = 0;
+        end = text.length();
     }
-    return spcre->getEveryMatchInfo(text).count();
+    return spcre->getEveryMatchInfo(text, start, end).count();
 }
 
 
 bool CodeViewEditor::ReplaceSelected(const QString &search_regex, const QString &replacement, Searchable::Direction direction, bool replace_current)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     int selection_start = textCursor().selectionStart();
     int selection_end = textCursor().selectionEnd();
 
@@ -964,33 +1120,35 @@ int CodeViewEditor::ReplaceAll(const QString &search_regex,
     }
     int marked_text_length = text.length();
 
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
 
-    // Run though all match offsets making the replacement in reverse order.
-    // This way changes in text length won't change the offsets as we make
-    // our changes.
-    for (int i = match_info.count() - 1; i >= 0; i--) {
-        QString replaced_text;
-        if (!wrap) {
+    // Without wrap only the matches from the end of the text back to the
+    // first one that is on the wrong side of the cursor are replaced.
+    int first_match = 0;
+    if (!wrap) {
+        first_match = match_info.count();
+        while (first_match > 0) {
+            const SPCRE::MatchInfo &match = match_info.at(first_match - 1);
             if (direction == Searchable::Direction_Up) {
-                if (match_info.at(i).offset.first > position) {
+                if (match.offset.first > position) {
                     break;
                 }
-            } else { 
-                if (match_info.at(i).offset.second < position) {
+            } else {
+                if (match.offset.second < position) {
                     break;
                 }
             }
+            first_match--;
         }
+        match_info = match_info.mid(first_match);
+    }
 
-        bool replacement_made = spcre->replaceText(Utility::Substring(match_info.at(i).offset.first, match_info.at(i).offset.second, text), match_info.at(i).capture_groups_offsets, replacement, replaced_text);
-
-        if (replacement_made) {
-            // Replace the text.
-            text = text.replace(match_info.at(i).offset.first, match_info.at(i).offset.second - match_info.at(i).offset.first, replaced_text);
-            count++;
-        }
+    if (!match_info.isEmpty()) {
+        // Build the new text in one pass over the matches.
+        QString replaced_text;
+        count = spcre->replaceEveryMatch(text, match_info, replacement, replaced_text);
+        text = replaced_text;
     }
     if (marked_text) {
         // Merge the replaced marked text into the original text and adjust the marker.
@@ -2028,6 +2186,13 @@ void CodeViewEditor::HighlightWord(const QString &word, int pos)
 
 void CodeViewEditor::RefreshSpellingHighlighting()
 {
+    // Editors without focus are rehighlighted once they get it, but any
+    // block repainted before then must already follow the current setting
+    XHTMLHighlighter *xhtml_highlighter = qobject_cast<XHTMLHighlighter *>(m_Highlighter);
+    if (xhtml_highlighter) {
+        xhtml_highlighter->RefreshSpellCheckSetting();
+    }
+
     if (hasFocus()) {
         RehighlightDocument();
     }
@@ -2266,19 +2431,14 @@ QList<ElementIndex> CodeViewEditor::GetCaretLocation()
     int pos = textCursor().position();
     int offset = 0;
     int len = 0;
-    QRegularExpression tag(XML_OPENING_TAG);
-    QRegularExpressionMatchIterator i = tag.globalMatch(toPlainText());
-    // There is no way to search for the last match (str.lastIndexOf) in a string and also have
-    // the matched text length. So we search forward for every match (QRegularExpression doesn't
-    // have a way to search backwards) and only use the last match's info.
-    while (i.hasNext()) {
-        QRegularExpressionMatch mo = i.next();
-        int start = mo.capturedStart();
-        if (start > pos) {
-            break;
-        }
-        offset = start;
-        len = mo.capturedLength();
+    // There is no way to search backwards for the last match so we keep an
+    // index of every opening tag that is updated as the text changes.
+    UpdateTagIndex(toPlainText());
+    QList<std::pair<int, int>>::const_iterator after = std::upper_bound(m_TagIndex.constBegin(), m_TagIndex.constEnd(), pos,
+        [](int value, const std::pair<int, int> &tag) { return value < tag.first; });
+    if (after != m_TagIndex.constBegin()) {
+        offset = (after - 1)->first;
+        len = (after - 1)->second;
     }
     QList<ElementIndex> hierarchy = ConvertStackToHierarchy(GetCaretLocationStack(offset + len));
 
@@ -3850,6 +4010,7 @@ void CodeViewEditor::ConnectSignalsToSlots()
     connect(this, SIGNAL(textChanged()), this, SLOT(TextChangedFilter()));
     connect(this, SIGNAL(undoAvailable(bool)), this, SLOT(UpdateUndoAvailable(bool)));
     connect(this, SIGNAL(selectionChanged()), this, SLOT(ResetLastFindMatch()));
+    connect(document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(DocumentContentsChange(int, int, int)));
     connect(m_ScrollOneLineUp,   SIGNAL(activated()), this, SLOT(ScrollOneLineUp()));
     connect(m_ScrollOneLineDown, SIGNAL(activated()), this, SLOT(ScrollOneLineDown()));
     connect(m_spellingMapper, SIGNAL(mapped(const QString &)), this, SLOT(InsertText(const QString &)));
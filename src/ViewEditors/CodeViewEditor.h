@@ -240,6 +240,21 @@ public:
                                        const QString &search_regex,
                                        Searchable::Direction search_direction);
 
+    /**
+     * Returns the last match of search_regex in text[start, end).
+     *
+     * The matches of the whole text are indexed once per document revision
+     * so repeated searches backwards only rescan the text between the
+     * previous match and the end, not everything from start. Patterns that
+     * can see past the end of a match (lookaround, anchors and the like)
+     * are still rescanned from start.
+     */
+    SPCRE::MatchInfo GetLastMatchBefore(SPCRE *spcre,
+                                        const QString &search_regex,
+                                        const QString &text,
+                                        int start,
+                                        int end);
+
     bool FindNext(const QString &search_regex,
                   Searchable::Direction search_direction,
                   bool misspelled_words = false,
@@ -499,6 +514,12 @@ protected:
 private slots:
     void ResetLastFindMatch();
 
+    /**
+     * Keeps the text snapshot and the tag index in step with
+     * changes to the document.
+     */
+    void DocumentContentsChange(int position, int chars_removed, int chars_added);
+
     void EmitFilteredCursorMoved();
 
     /**
@@ -669,6 +690,14 @@ private:
      */
     QStack<StackElement> GetCaretLocationStack(int offset) const;
 
+    /**
+     * Brings the opening tag index up to date with the text,
+     * rescanning only what changed since it was last used.
+     *
+     * @param text The current document text.
+     */
+    void UpdateTagIndex(const QString &text);
+
     /**
      * Takes the stack provided by GetCaretLocationStack()
      * and converts it into the element location hierarchy
@@ -843,6 +872,39 @@ private:
     SPCRE::MatchInfo m_lastMatch;
     QString m_lastFindRegex;
 
+    /**
+     * The offsets (relative to m_FindIndexStart) of every match of
+     * m_FindIndexRegex in the document at m_FindIndexRevision.
+     * Used to search backwards without rescanning the whole document.
+     */
+    QList<std::pair<int, int>> m_FindIndexOffsets;
+    QString m_FindIndexRegex;
+    int m_FindIndexRevision;
+    int m_FindIndexStart;
+
+    /**
+     * Counts changes to the document text so that what is derived from
+     * the text can be reused until it changes.
+     */
+    int m_ContentsRevision;
+
+    /**
+     * The document text as of m_TextSnapshotRevision, shared by toPlainText().
+     */
+    mutable QString m_TextSnapshot;
+    mutable int m_TextSnapshotRevision;
+
+    /**
+     * The (offset, length) of every opening tag in the document, used to
+     * find the element containing the caret. Changes only invalidate the
+     * part between m_TagDirtyStart and m_TagDirtyEnd, which is rescanned
+     * the next time the index is needed.
+     */
+    QList<std::pair<int, int>> m_TagIndex;
+    bool m_TagIndexValid;
+    int m_TagDirtyStart;
+    int m_TagDirtyEnd;
+
     /**
      * Map spelling suggestion actions from the context menu to the
      * ReplaceSelected slot.
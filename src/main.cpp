@@ -22,6 +22,7 @@
 *************************************************************************/
 
 #include "Misc/EmbeddedPython.h"
+#include "Misc/PythonWorkerPool.h"
 #include <iostream>
 
 #include <QtCore/QCoreApplication>
@@ -318,6 +319,15 @@ int main(int argc, char *argv[])
     QCoreApplication::setApplicationName("sigil");
     QCoreApplication::setApplicationVersion(SIGIL_VERSION);
 
+    // Headless helper process used to run embedded python jobs in parallel
+    if ((argc > 1) && (QString::fromLocal8Bit(argv[1]) == PythonWorkerPool::PYTHON_WORKER_ARG)) {
+        QCoreApplication worker_app(argc, argv);
+        EmbeddedPython* epython = EmbeddedPython::instance();
+        epython->addToPythonSysPath(epython->embeddedRoot());
+        epython->addToPythonSysPath(PluginDB::launcherRoot() + "/python");
+        return PythonWorkerPool::RunWorker();
+    }
+
 #ifndef Q_OS_MAC
     setupHighDPI();
 #endif